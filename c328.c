@@ -29,6 +29,10 @@
 uint8_t rxbuf[RXBUF_LEN];
 uint16_t rxbuf_len = 0;
 
+/* Command responses are kept apart from the image data, which may still
+ * be in use by the reader while other commands are sent */
+static uint8_t cmdbuf[6];
+
 /* Expected package size */
 static uint16_t pkg_len = 64; /* Default is 64 according to datasheet */
 
@@ -44,22 +48,21 @@ static void tx_byte(uint8_t b)
 static uint8_t c3_rx(to_int timeout)
 {
 	to_int to;
-	
-	rxbuf_len = 0;
+	uint8_t len = 0;
 	
 	to = to_clock();
 	while(to_since(to) < timeout)
 	{
 		if(!RXREADY) continue;
-		rxbuf[rxbuf_len++] = UDR0;
-		if(rxbuf_len == 6) break;
+		cmdbuf[len++] = UDR0;
+		if(len == 6) break;
 	}
 	
-	if(rxbuf_len != 6) return(0); /* Timeout or incomplete response */
-	if(rxbuf[0] != 0xAA) return(0); /* All responses should begin 0xAA */
+	if(len != 6) return(0); /* Timeout or incomplete response */
+	if(cmdbuf[0] != 0xAA) return(0); /* All responses should begin 0xAA */
 	
 	/* Return the received command ID */
-	return(rxbuf[1]);
+	return(cmdbuf[1]);
 }
 
 static void c3_tx(uint8_t cmd, uint8_t a1, uint8_t a2, uint8_t a3, uint8_t a4)
@@ -80,7 +83,7 @@ static char c3_cmd(uint8_t cmd, uint8_t a1, uint8_t a2, uint8_t a3, uint8_t a4)
 	r = c3_rx(CMD_TIMEOUT);
 	
 	/* Did we get an ACK for this command? */
-	if(r != CMD_ACK || rxbuf[2] != cmd) return(-1);
+	if(r != CMD_ACK || cmdbuf[2] != cmd) return(-1);
 	
 	return(0);
 }
@@ -153,7 +156,7 @@ char c3_get_picture(uint8_t pt, uint16_t *length)
 	if(c3_rx(PIC_TIMEOUT) != CMD_DATA) return(-1);
 	
 	/* Get the file size from the DATA args */
-	*length = rxbuf[3] + (rxbuf[4] << 8);
+	*length = cmdbuf[3] + (cmdbuf[4] << 8);
 	
 	return(0);
 }
@@ -234,12 +237,19 @@ char c3_open(uint8_t jr)
 	if(c3_snapshot(ST_JPEG, 0) != 0) return(-4);
 	if(c3_get_picture(PT_SNAPSHOT, &image_len) != 0) return(-5);
 	
+	c3_rewind();
+	
+	return(0);
+}
+
+void c3_rewind(void)
+{
+	/* The camera sends any package asked for, so the
+	 * image can be read again from the start */
 	image_read = 0;
 	package = NULL;
 	package_len = 0;
 	package_id = 0;
-	
-	return(0);
 }
 
 char c3_close(void)
@@ -248,6 +258,18 @@ char c3_close(void)
 	return(0);
 }
 
+static char c3_next_package(void)
+{
+	char i = c3_get_package(package_id++, &package, &package_len);
+	if(i != 0) return(i);
+	
+	/* Skip the package headers and checksum */
+	package += 4;
+	package_len -= 6;
+	
+	return(0);
+}
+
 uint16_t c3_read(uint8_t *ptr, uint16_t length)
 {
 	uint16_t r; /* Number of bytes left to read */
@@ -261,12 +283,7 @@ uint16_t c3_read(uint8_t *ptr, uint16_t length)
 	{
 		if(package_len == 0)
 		{
-			char i = c3_get_package(package_id++, &package, &package_len);
-			if(i != 0) return(length - r);
-			
-			/* Skip the package headers and checksum */
-			package += 4;
-			package_len -= 6;
+			if(c3_next_package() != 0) return(length - r);
 		}
 		else
 		{
@@ -291,6 +308,26 @@ uint16_t c3_read(uint8_t *ptr, uint16_t length)
 	return(length);
 }
 
+uint16_t c3_peek(uint8_t **ptr)
+{
+	uint16_t r; /* Number of bytes left to read */
+	
+	/* Don't read past the end of the image */
+	r = image_len - image_read;
+	if(r == 0) return(0);
+	
+	if(package_len == 0)
+	{
+		if(c3_next_package() != 0) return(0);
+	}
+	
+	/* The data stays in rxbuf until it's all been read with c3_read() */
+	if(r > package_len) r = package_len;
+	*ptr = package;
+	
+	return(r);
+}
+
 uint16_t c3_filesize(void)
 {
 	return(image_len);
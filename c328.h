@@ -102,7 +102,9 @@ extern char c3_finish_picture(void);
 
 extern char c3_open(uint8_t jr);
 extern char c3_close(void);
+extern void c3_rewind(void);
 extern uint16_t c3_read(uint8_t *ptr, uint16_t length);
+extern uint16_t c3_peek(uint8_t **ptr);
 extern uint16_t c3_filesize(void);
 extern char c3_eof(void);
 
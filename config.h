@@ -11,5 +11,45 @@
 #define RTTY_BAUD (300)
 
 //#define SSDV_ENABLED
+#define SSDV_PKT_LENGTH (256) /* 64 - 256 bytes, in steps of 32 */
+#define SSDV_QUALITY    (4)   /* 0 - 7 */
+
+/* Packets encoded ahead of the transmitter, SSDV_PKT_LENGTH bytes of
+ * RAM each. With 2 the next is ready as soon as the last has gone */
+#define SSDV_RING_SLOTS (2)
+
+/* Pick the quality for each image to fit this many packets */
+//#define SSDV_TARGET_PACKETS (60)
+
+/* Send each image in two passes, the DC values and then the AC values */
+//#define SSDV_PROGRESSIVE
+
+/* Send only the luma of each image, the decoder fills in flat chroma */
+//#define SSDV_GRAYSCALE
+
+/* Scale each image down to half or quarter size as it's encoded. Quarter
+ * size needs a whole row of MCUs in RAM, see SSDV_SCALE_LEN() */
+//#define SSDV_IMAGE_SCALE (SSDV_SCALE_HALF)
+
+/* Send only a window of each image, x, y, width and height in 16 pixel
+ * units. This is the middle third of the 320x240 camera image */
+//#define SSDV_IMAGE_CROP 0, 5, 20, 5
+
+/* RS codes in each packet, 32, 16 or 8. Fewer leave more room for image
+ * data on a good link, but correct fewer errors */
+#define SSDV_FEC_ROOTS (32)
+
+/* Leave out the RS codes below this altitude in metres, while the
+ * receivers are close. Their space carries image data instead */
+//#define SSDV_NOFEC_BELOW (2000)
+
+/* Calculate the CRC and RS codes of each packet in a single pass */
+//#define SSDV_FUSED_FEC
+
+/* Follow every group of this many packets with parity packets, which let
+ * the receivers rebuild as many lost packets of the group. Each parity
+ * packet needs SSDV_PKT_LENGTH bytes of RAM while the group is sent */
+//#define SSDV_PARITY_GROUP   (16)
+#define SSDV_PARITY_PACKETS (1)
 
 #endif
@@ -0,0 +1,70 @@
+
+/* dhcgen - Make the huffman code tables for ssdv.c                      */
+/*=======================================================================*/
+/* Copyright 2026 agent <agent@local>                                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* This is a host tool, run by "make std_dhc" to write std_dhc.h. It
+ * assigns the codes of each table in std_dht.h the way a JPEG decoder
+ * does, and writes them out indexed by symbol for the encoder.
+ *
+ * Each entry is the code width followed by the code, MSB first. A width
+ * of 0 marks a symbol with no code. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#include "std_dht.h"
+
+static void make_table(const char *name, const uint8_t *dht, int size)
+{
+	uint8_t dhc[256 * 3];
+	const uint8_t *ss = &dht[17];
+	uint16_t code = 0;
+	int cw, n, i;
+	
+	memset(dhc, 0, sizeof(dhc));
+	
+	for(cw = 1; cw <= 16; cw++, code <<= 1)
+	{
+		for(n = dht[cw]; n > 0; n--, ss++, code++)
+		{
+			dhc[*ss * 3 + 0] = cw;
+			dhc[*ss * 3 + 1] = code >> 8;
+			dhc[*ss * 3 + 2] = code & 0xFF;
+		}
+	}
+	
+	printf("PROGMEM static uint8_t const %s[%i] = {", name, size);
+	for(i = 0; i < size; i++)
+		printf("%s0x%02X,", i % 15 ? "" : "\n", dhc[i]);
+	printf("\n};\n\n");
+}
+
+int main(void)
+{
+	printf("/* Made by dhcgen, do not edit */\n\n");
+	
+	/* The DC tables only have symbols 0 to 15 */
+	make_table("std_dhc00", std_dht00, 16 * 3);
+	make_table("std_dhc01", std_dht01, 16 * 3);
+	make_table("std_dhc10", std_dht10, 256 * 3);
+	make_table("std_dhc11", std_dht11, 256 * 3);
+	
+	return(0);
+}
+
@@ -8,5 +8,36 @@
 
 #include <stdint.h>
 
+#ifndef INC_RS8_H
+#define INC_RS8_H
+
+/* A code with nroots parity bytes. rs8poly.h has one for each number of
+ * roots the Makefile asks rs8gen for, rs8_code() finds them */
+typedef struct
+{
+	uint8_t nroots;       /* Number of parity bytes, up to RS8_NROOTS_MAX */
+	uint8_t fcr;          /* First consecutive root */
+	const uint8_t *poly;  /* The generator polynomial in log form, in flash */
+} rs8_code_t;
+
+#define RS8_NROOTS_MAX (32)
+
+extern const rs8_code_t *rs8_code(uint8_t nroots);
+extern void rs8_encode(const rs8_code_t *code, uint8_t *data, uint8_t *parity, int pad);
+extern void rs8_encode_byte(const rs8_code_t *code, uint8_t data, uint8_t *parity);
+
+/* The same with the 32 root code */
 extern void encode_rs_8(uint8_t *data, uint8_t *parity, int pad);
+extern void encode_rs_8_byte(uint8_t data, uint8_t *parity);
+
+extern uint8_t rs8_mul(uint8_t a, uint8_t b);
+extern uint8_t rs8_div(uint8_t a, uint8_t b);
+extern void rs8_muladd(uint8_t *dst, const uint8_t *src, uint8_t c, int len);
+
+#ifndef __AVR__
+extern int rs8_decode(const rs8_code_t *code, uint8_t *data, int *eras_pos, int no_eras, int pad);
+extern int decode_rs_8(uint8_t *data, int *eras_pos, int no_eras, int pad);
+#endif
+
+#endif
 
@@ -0,0 +1,378 @@
+/* Reed-Solomon decoder
+ * Copyright 2002, Phil Karn, KA9Q
+ * May be used under the terms of the GNU Lesser General Public License (LGPL)
+ *
+ * This version modified for the ground station. It takes the same codes
+ * as rs8encode.c, and works out the syndromes with SSSE3 or AVX2 table
+ * lookups when the CPU has them.
+ */
+
+#ifndef __AVR__
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RS8_X86
+#endif
+#include "rs8.h"
+
+#define MM     (8)
+#define NN     (255)
+#define PRIM   (11)
+#define IPRIM  (116)
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#define A0       (NN) /* Special reserved value encoding zero in index form */
+
+/* The field tables in rs8encode.c */
+extern const uint8_t alpha_to[];
+extern const uint8_t index_of[];
+
+static inline int modnn(int x)
+{
+	while(x >= NN)
+	{
+		x -= NN;
+		x = (x >> MM) + (x & NN);
+	}
+	return(x);
+}
+
+/* The roots of every code rs8gen makes are among those of the 32 root
+ * code, so its 32 syndromes are worked out and each code takes its own */
+#define NSYN   (RS8_NROOTS_MAX)
+#define FCR    (128 - NSYN / 2)
+
+/* The syndromes are sums of each byte times a constant for its position,
+ * one constant per syndrome. A byte r times a constant c is
+ * mul_lo[r][c & 15] ^ mul_hi[r][c >> 4], which pshufb looks up for 16 or
+ * 32 constants at once. pow_lo[e] and pow_hi[e] hold the nibbles of the
+ * constants for the byte e places from the end of the block */
+static uint8_t mul_lo[256][16] __attribute__((aligned(32)));
+static uint8_t mul_hi[256][16] __attribute__((aligned(32)));
+static uint8_t pow_lo[NN][NSYN] __attribute__((aligned(32)));
+static uint8_t pow_hi[NN][NSYN] __attribute__((aligned(32)));
+
+static void (*syndromes)(const uint8_t *data, int len, uint8_t *s);
+static pthread_once_t syndromes_once = PTHREAD_ONCE_INIT;
+
+/* Portable C version */
+static void syndromes_c(const uint8_t *data, int len, uint8_t *s)
+{
+	int i, j;
+	
+	for(i = 0; i < NSYN; i++)
+		s[i] = data[0];
+	
+	for(j = 1; j < len; j++)
+	{
+		for(i = 0; i < NSYN; i++)
+		{
+			if(s[i] == 0) s[i] = data[j];
+			else s[i] = data[j] ^ alpha_to[modnn(index_of[s[i]] + (FCR + i) * PRIM)];
+		}
+	}
+}
+
+#ifdef RS8_X86
+__attribute__((target("ssse3")))
+static void syndromes_ssse3(const uint8_t *data, int len, uint8_t *s)
+{
+	__m128i s0 = _mm_setzero_si128();
+	__m128i s1 = _mm_setzero_si128();
+	__m128i lo, hi;
+	int j, e;
+	
+	for(j = 0, e = len - 1; j < len; j++, e--)
+	{
+		lo = _mm_load_si128((const __m128i *) mul_lo[data[j]]);
+		hi = _mm_load_si128((const __m128i *) mul_hi[data[j]]);
+		
+		s0 = _mm_xor_si128(s0, _mm_xor_si128(
+			_mm_shuffle_epi8(lo, _mm_load_si128((const __m128i *) &pow_lo[e][0])),
+			_mm_shuffle_epi8(hi, _mm_load_si128((const __m128i *) &pow_hi[e][0]))));
+		s1 = _mm_xor_si128(s1, _mm_xor_si128(
+			_mm_shuffle_epi8(lo, _mm_load_si128((const __m128i *) &pow_lo[e][16])),
+			_mm_shuffle_epi8(hi, _mm_load_si128((const __m128i *) &pow_hi[e][16]))));
+	}
+	
+	_mm_storeu_si128((__m128i *) &s[0], s0);
+	_mm_storeu_si128((__m128i *) &s[16], s1);
+}
+
+__attribute__((target("avx2")))
+static void syndromes_avx2(const uint8_t *data, int len, uint8_t *s)
+{
+	__m256i s0 = _mm256_setzero_si256();
+	__m256i lo, hi;
+	int j, e;
+	
+	for(j = 0, e = len - 1; j < len; j++, e--)
+	{
+		lo = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) mul_lo[data[j]]));
+		hi = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) mul_hi[data[j]]));
+		
+		s0 = _mm256_xor_si256(s0, _mm256_xor_si256(
+			_mm256_shuffle_epi8(lo, _mm256_load_si256((const __m256i *) pow_lo[e])),
+			_mm256_shuffle_epi8(hi, _mm256_load_si256((const __m256i *) pow_hi[e]))));
+	}
+	
+	_mm256_storeu_si256((__m256i *) s, s0);
+}
+#endif
+
+static void syndromes_init(void)
+{
+	int r, c, e, i;
+	uint8_t w;
+	
+	for(r = 0; r < 256; r++)
+	{
+		for(c = 0; c < 16; c++)
+		{
+			mul_lo[r][c] = rs8_mul(r, c);
+			mul_hi[r][c] = rs8_mul(r, c << 4);
+		}
+	}
+	
+	/* Syndrome i multiplies the byte e places from the end by
+	 * alpha^((FCR + i) * PRIM * e) */
+	for(i = 0; i < NSYN; i++)
+	{
+		for(e = 0; e < NN; e++)
+		{
+			w = alpha_to[(FCR + i) * PRIM * e % NN];
+			pow_lo[e][i] = w & 0x0F;
+			pow_hi[e][i] = w >> 4;
+		}
+	}
+	
+	syndromes = syndromes_c;
+	
+#ifdef RS8_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) syndromes = syndromes_avx2;
+	else if(__builtin_cpu_supports("ssse3")) syndromes = syndromes_ssse3;
+#endif
+}
+
+/* Correct the errors in a block of NN - pad bytes, the data followed by
+ * the parity. eras_pos lists no_eras known bad bytes, counted from the
+ * start of data. Returns the number of bytes corrected, or -1 if there
+ * were too many errors, in which case data is left as it was. If
+ * eras_pos is not NULL it must have room for nroots places, and is
+ * filled with the places corrected */
+int rs8_decode(const rs8_code_t *code, uint8_t *data, int *eras_pos, int no_eras, int pad)
+{
+	int deg_lambda, el, deg_omega;
+	int i, j, r, k;
+	uint8_t u, q, tmp, num1, num2, den, discr_r;
+	uint8_t lambda[NSYN + 1], s[NSYN], syn[NSYN];
+	uint8_t b[NSYN + 1], t[NSYN + 1], omega[NSYN + 1];
+	uint8_t root[NSYN], reg[NSYN + 1], loc[NSYN];
+	int syn_error, count;
+	int nroots = code->nroots, fcr = code->fcr;
+	
+	if(fcr < FCR || fcr + nroots > FCR + NSYN) return(-1);
+	if(pad < 0 || pad > NN - nroots - 1) return(-1);
+	if(no_eras < 0 || no_eras > nroots) return(-1);
+	for(i = 0; i < no_eras; i++)
+		if(eras_pos[i] < 0 || eras_pos[i] >= NN - pad) return(-1);
+	
+	pthread_once(&syndromes_once, syndromes_init);
+	
+	/* Form the syndromes, data(x) at the roots of g(x) */
+	syndromes(data, NN - pad, syn);
+	memcpy(s, &syn[fcr - FCR], nroots);
+	
+	/* Convert syndromes to index form, checking for nonzero condition */
+	syn_error = 0;
+	for(i = 0; i < nroots; i++)
+	{
+		syn_error |= s[i];
+		s[i] = index_of[s[i]];
+	}
+	
+	if(!syn_error)
+	{
+		/* data[] is a codeword, there is nothing to correct */
+		count = 0;
+		goto finish;
+	}
+	
+	memset(&lambda[1], 0, nroots * sizeof(lambda[0]));
+	lambda[0] = 1;
+	
+	if(no_eras > 0)
+	{
+		/* Init lambda to be the erasure locator polynomial */
+		lambda[1] = alpha_to[modnn(PRIM * (NN - 1 - (eras_pos[0] + pad)))];
+		for(i = 1; i < no_eras; i++)
+		{
+			u = modnn(PRIM * (NN - 1 - (eras_pos[i] + pad)));
+			for(j = i + 1; j > 0; j--)
+			{
+				tmp = index_of[lambda[j - 1]];
+				if(tmp != A0) lambda[j] ^= alpha_to[modnn(u + tmp)];
+			}
+		}
+	}
+	
+	for(i = 0; i < nroots + 1; i++)
+		b[i] = index_of[lambda[i]];
+	
+	/* Berlekamp-Massey, for the error+erasure locator polynomial */
+	r = no_eras;
+	el = no_eras;
+	while(++r <= nroots)
+	{
+		/* Compute discrepancy at the r-th step in poly-form */
+		discr_r = 0;
+		for(i = 0; i < r; i++)
+		{
+			if(lambda[i] != 0 && s[r - i - 1] != A0)
+				discr_r ^= alpha_to[modnn(index_of[lambda[i]] + s[r - i - 1])];
+		}
+		discr_r = index_of[discr_r];
+		
+		if(discr_r == A0)
+		{
+			/* B(x) <-- x*B(x) */
+			memmove(&b[1], b, nroots * sizeof(b[0]));
+			b[0] = A0;
+		}
+		else
+		{
+			/* T(x) <-- lambda(x) - discr_r*x*b(x) */
+			t[0] = lambda[0];
+			for(i = 0; i < nroots; i++)
+			{
+				if(b[i] != A0) t[i + 1] = lambda[i + 1] ^ alpha_to[modnn(discr_r + b[i])];
+				else t[i + 1] = lambda[i + 1];
+			}
+			
+			if(2 * el <= r + no_eras - 1)
+			{
+				el = r + no_eras - el;
+				
+				/* B(x) <-- inv(discr_r) * lambda(x) */
+				for(i = 0; i <= nroots; i++)
+					b[i] = (lambda[i] == 0) ? A0 : modnn(index_of[lambda[i]] - discr_r + NN);
+			}
+			else
+			{
+				/* B(x) <-- x*B(x) */
+				memmove(&b[1], b, nroots * sizeof(b[0]));
+				b[0] = A0;
+			}
+			
+			memcpy(lambda, t, (nroots + 1) * sizeof(t[0]));
+		}
+	}
+	
+	/* Convert lambda to index form and compute deg(lambda(x)) */
+	deg_lambda = 0;
+	for(i = 0; i < nroots + 1; i++)
+	{
+		lambda[i] = index_of[lambda[i]];
+		if(lambda[i] != A0) deg_lambda = i;
+	}
+	
+	/* Find the roots of the error+erasure locator by Chien search */
+	memcpy(&reg[1], &lambda[1], nroots * sizeof(reg[0]));
+	count = 0;
+	for(i = 1, k = IPRIM - 1; i <= NN; i++, k = modnn(k + IPRIM))
+	{
+		q = 1; /* lambda[0] is always 0 */
+		for(j = deg_lambda; j > 0; j--)
+		{
+			if(reg[j] != A0)
+			{
+				reg[j] = modnn(reg[j] + j);
+				q ^= alpha_to[reg[j]];
+			}
+		}
+		
+		if(q != 0) continue; /* Not a root */
+		
+		/* A root in the padding is an error that cannot be there */
+		if(k < pad)
+		{
+			count = -1;
+			goto finish;
+		}
+		
+		/* Store root (index-form) and error location number */
+		root[count] = i;
+		loc[count] = k;
+		
+		/* Stop once all the roots are found */
+		if(++count == deg_lambda) break;
+	}
+	
+	if(deg_lambda != count)
+	{
+		/* deg(lambda) unequal to number of roots, uncorrectable */
+		count = -1;
+		goto finish;
+	}
+	
+	/* Compute the err+eras evaluator poly omega(x) = s(x)*lambda(x)
+	 * (modulo x**nroots) in index form. Also find deg(omega) */
+	deg_omega = deg_lambda - 1;
+	for(i = 0; i <= deg_omega; i++)
+	{
+		tmp = 0;
+		for(j = i; j >= 0; j--)
+		{
+			if(s[i - j] != A0 && lambda[j] != A0)
+				tmp ^= alpha_to[modnn(s[i - j] + lambda[j])];
+		}
+		omega[i] = index_of[tmp];
+	}
+	
+	/* Compute the error values in poly-form. num1 = omega(inv(X(l))),
+	 * num2 = inv(X(l))**(FCR-1) and den = lambda_pr(inv(X(l))) */
+	for(j = count - 1; j >= 0; j--)
+	{
+		num1 = 0;
+		for(i = deg_omega; i >= 0; i--)
+		{
+			if(omega[i] != A0)
+				num1 ^= alpha_to[modnn(omega[i] + i * root[j])];
+		}
+		
+		num2 = alpha_to[modnn(root[j] * (fcr - 1) + NN)];
+		den = 0;
+		
+		/* lambda[i+1] for i even is the formal derivative lambda_pr of lambda[i] */
+		for(i = MIN(deg_lambda, nroots - 1) & ~1; i >= 0; i -= 2)
+		{
+			if(lambda[i + 1] != A0)
+				den ^= alpha_to[modnn(lambda[i + 1] + i * root[j])];
+		}
+		
+		/* Apply error to data */
+		if(num1 != 0)
+			data[loc[j] - pad] ^= alpha_to[modnn(index_of[num1] + index_of[num2] + NN - index_of[den])];
+	}
+
+finish:
+	if(eras_pos != NULL)
+	{
+		for(i = 0; i < count; i++)
+			eras_pos[i] = loc[i] - pad;
+	}
+	
+	return(count);
+}
+
+int decode_rs_8(uint8_t *data, int *eras_pos, int no_eras, int pad)
+{
+	return(rs8_decode(rs8_code(32), data, eras_pos, no_eras, pad));
+}
+
+#endif
+
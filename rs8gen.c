@@ -0,0 +1,136 @@
+
+/* rs8gen - Make the generator polynomials for rs8encode.c               */
+/*=======================================================================*/
+/* Copyright 2026 agent <agent@local>                                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* This is a host tool, run by the Makefile to write rs8poly.h. It makes
+ * a code for each number of roots given, in the field of rs8encode.c.
+ *
+ * The roots of each code are centred on alpha^(127.5 * PRIM) the way the
+ * 32 root CCSDS code's are, so the first is 128 - nroots / 2. The roots
+ * of the smaller codes are then a subset of the larger ones, and their
+ * generator polynomials are symmetric. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define MM     (8)
+#define NN     (255)
+#define GFPOLY (0x187)
+#define PRIM   (11)
+#define A0     (NN)
+
+static uint8_t alpha_to[NN + 1];
+static uint8_t index_of[NN + 1];
+
+static int modnn(int x)
+{
+	while(x >= NN)
+	{
+		x -= NN;
+		x = (x >> MM) + (x & NN);
+	}
+	return(x);
+}
+
+static void make_field(void)
+{
+	int i, sr;
+	
+	index_of[0] = A0;
+	alpha_to[A0] = 0;
+	
+	for(sr = 1, i = 0; i < NN; i++)
+	{
+		index_of[sr] = i;
+		alpha_to[i] = sr;
+		sr <<= 1;
+		if(sr & (1 << MM)) sr ^= GFPOLY;
+	}
+}
+
+/* The product of (x - alpha^(root * PRIM)) for each root, in log form */
+static void make_poly(uint8_t *poly, int nroots, int fcr)
+{
+	int i, j, root;
+	
+	poly[0] = 1;
+	for(i = 0, root = fcr * PRIM; i < nroots; i++, root += PRIM)
+	{
+		poly[i + 1] = 1;
+		
+		/* Multiply poly[] by (x + alpha^root) */
+		for(j = i; j > 0; j--)
+		{
+			if(poly[j] != 0)
+				poly[j] = poly[j - 1] ^ alpha_to[modnn(index_of[poly[j]] + root)];
+			else
+				poly[j] = poly[j - 1];
+		}
+		poly[0] = alpha_to[modnn(index_of[poly[0]] + root)];
+	}
+	
+	for(i = 0; i <= nroots; i++)
+		poly[i] = index_of[poly[i]];
+}
+
+int main(int argc, char *argv[])
+{
+	uint8_t poly[NN];
+	int nroots[16];
+	int i, j, n = argc - 1;
+	
+	if(n < 1 || n > 16)
+	{
+		fprintf(stderr, "Usage: rs8gen <nroots> [...]\n");
+		return(-1);
+	}
+	
+	for(i = 0; i < n; i++)
+	{
+		/* The decoder works on up to 32 roots at once */
+		nroots[i] = atoi(argv[i + 1]);
+		if(nroots[i] < 2 || nroots[i] > 32 || nroots[i] & 1)
+		{
+			fprintf(stderr, "Number of roots must be even, 2 to 32\n");
+			return(-1);
+		}
+	}
+	
+	make_field();
+	
+	printf("/* Made by rs8gen, do not edit */\n\n");
+	printf("#define RS8_NCODES (%i)\n\n", n);
+	
+	for(i = 0; i < n; i++)
+	{
+		make_poly(poly, nroots[i], 128 - nroots[i] / 2);
+		
+		printf("PROGMEM const uint8_t poly%i[] = {", nroots[i]);
+		for(j = 0; j <= nroots[i]; j++)
+			printf("%s0x%02X,", j % 16 ? "" : "\n", poly[j]);
+		printf("\n};\n\n");
+	}
+	
+	printf("const rs8_code_t rs8_codes[RS8_NCODES] = {\n");
+	for(i = 0; i < n; i++)
+		printf("\t{ %i, %i, poly%i },\n", nroots[i], 128 - nroots[i] / 2, nroots[i]);
+	printf("};\n\n");
+	
+	return(0);
+}
+
@@ -0,0 +1,25 @@
+/* Made by rs8gen, do not edit */
+
+#define RS8_NCODES (3)
+
+PROGMEM const uint8_t poly8[] = {
+0x00,0x30,0x9A,0x1C,0x95,0x1C,0x9A,0x30,0x00,
+};
+
+PROGMEM const uint8_t poly16[] = {
+0x00,0x1E,0xE6,0x31,0xEB,0x81,0x51,0x4C,0xAD,0x4C,0x51,0x81,0xEB,0x31,0xE6,0x1E,
+0x00,
+};
+
+PROGMEM const uint8_t poly32[] = {
+0x00,0xF9,0x3B,0x42,0x04,0x2B,0x7E,0xFB,0x61,0x1E,0x03,0xD5,0x32,0x42,0xAA,0x05,
+0x18,0x05,0xAA,0x42,0x32,0xD5,0x03,0x1E,0x61,0xFB,0x7E,0x2B,0x04,0x42,0x3B,0xF9,
+0x00,
+};
+
+const rs8_code_t rs8_codes[RS8_NCODES] = {
+	{ 8, 124, poly8 },
+	{ 16, 120, poly16 },
+	{ 32, 112, poly32 },
+};
+
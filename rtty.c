@@ -23,6 +23,7 @@
 #include <avr/pgmspace.h>
 #include <string.h>
 #include "rtty.h"
+#include "ssdv.h"
 #include "timeout.h"
 
 /* MARK = Upper tone, Idle, bit  */
@@ -36,6 +37,11 @@ volatile static uint8_t  txpgm = 0;
 volatile static uint8_t *txbuf = 0;
 volatile static uint16_t txlen = 0;
 
+/* Packets from the ring go out whenever nothing else is waiting */
+static ssdv_ring_t *txring = 0;
+static uint8_t *ringbuf;
+static uint16_t ringlen = 0;
+
 ISR(TIMER0_COMPA_vect)
 {
 	/* The currently transmitting byte, including framing */
@@ -54,11 +60,26 @@ ISR(TIMER0_COMPA_vect)
 	
 	TXBIT(b);
 	
-	if(bit == 0 && txlen > 0)
+	if(bit == 0)
 	{
-		if(txpgm == 0) byte = *(txbuf++);
-		else byte = pgm_read_byte(txbuf++);
-		txlen--;
+		if(ringlen > 0)
+		{
+			/* A packet is always sent whole. Its slot is
+			 * free again once the last byte is taken */
+			byte = *(ringbuf++);
+			if(--ringlen == 0) ssdv_ring_pop(txring);
+		}
+		else if(txlen > 0)
+		{
+			if(txpgm == 0) byte = *(txbuf++);
+			else byte = pgm_read_byte(txbuf++);
+			txlen--;
+		}
+		else if(txring && (ringbuf = ssdv_ring_peek(txring)))
+		{
+			byte = *(ringbuf++);
+			ringlen = txring->pkt_size - 1;
+		}
 	}
 	
 	/* Timeout tick */
@@ -87,7 +108,8 @@ void rtx_init(void)
 
 void inline rtx_wait(void)
 {
-	/* Wait for interrupt driven TX to finish */
+	/* Wait for interrupt driven TX to finish. Packets
+	 * from the ring don't hold this up, they carry on */
 	while(txlen > 0) while(txlen > 0);
 }
 
@@ -119,3 +141,9 @@ void rtx_string_P(PGM_P s)
 	rtx_data_P(s, length);
 }
 
+void rtx_ring(ssdv_ring_t *ring)
+{
+	/* Set before interrupts are enabled */
+	txring = ring;
+}
+
@@ -22,6 +22,9 @@
 #include <stdint.h>
 #include <avr/pgmspace.h>
 
+/* The SSDV packet ring, from ssdv.h */
+struct ssdv_ring;
+
 extern void rtx_init(void);
 extern void rtx_enable(char en);
 extern void inline rtx_wait(void);
@@ -29,6 +32,7 @@ extern void rtx_data(uint8_t *data, size_t length);
 extern void rtx_data_P(PGM_P data, size_t length);
 extern void rtx_string(char *s);
 extern void rtx_string_P(PGM_P s);
+extern void rtx_ring(struct ssdv_ring *ring);
 
 #endif
 
@@ -16,9 +16,18 @@
 /* You should have received a copy of the GNU General Public License     */
 /* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
+#include "config.h"
 #include <stdint.h>
 #include <string.h>
+#ifdef __AVR__
 #include <avr/pgmspace.h>
+#else
+#define PROGMEM
+#define pgm_read_byte(a) (*(const uint8_t *) (a))
+#define pgm_read_word(a) (*(const uint16_t *) (a))
+#define memcpy_P memcpy
+#include <stdlib.h>
+#endif
 #include "ssdv.h"
 #include "rs8.h"
 
@@ -52,59 +61,91 @@ PROGMEM static uint8_t const std_dqt1[65] = {
 0x64,
 };
 
-/* Standard Huffman tables */
-PROGMEM static uint8_t const std_dht00[29] = {
-0x00,0x00,0x01,0x05,0x01,0x01,0x01,0x01,0x01,0x01,0x00,0x00,0x00,0x00,0x00,0x00,
-0x00,0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0A,0x0B,
+/* Scale of the above at each quality level, in 1/32nds */
+PROGMEM static uint8_t const dqt_scale[SSDV_QUALITY_LEVELS] = {
+0x80,0x58,0x40,0x2D,0x20,0x16,0x0D,0x06,
 };
 
-PROGMEM static uint8_t const std_dht01[29] = {
-0x01,0x00,0x03,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x00,0x00,0x00,0x00,
-0x00,0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0A,0x0B,
-};
-
-PROGMEM static uint8_t const std_dht10[179] = {
-0x10,0x00,0x02,0x01,0x03,0x03,0x02,0x04,0x03,0x05,0x05,0x04,0x04,0x00,0x00,0x01,
-0x7D,0x01,0x02,0x03,0x00,0x04,0x11,0x05,0x12,0x21,0x31,0x41,0x06,0x13,0x51,0x61,
-0x07,0x22,0x71,0x14,0x32,0x81,0x91,0xA1,0x08,0x23,0x42,0xB1,0xC1,0x15,0x52,0xD1,
-0xF0,0x24,0x33,0x62,0x72,0x82,0x09,0x0A,0x16,0x17,0x18,0x19,0x1A,0x25,0x26,0x27,
-0x28,0x29,0x2A,0x34,0x35,0x36,0x37,0x38,0x39,0x3A,0x43,0x44,0x45,0x46,0x47,0x48,
-0x49,0x4A,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5A,0x63,0x64,0x65,0x66,0x67,0x68,
-0x69,0x6A,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7A,0x83,0x84,0x85,0x86,0x87,0x88,
-0x89,0x8A,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9A,0xA2,0xA3,0xA4,0xA5,0xA6,
-0xA7,0xA8,0xA9,0xAA,0xB2,0xB3,0xB4,0xB5,0xB6,0xB7,0xB8,0xB9,0xBA,0xC2,0xC3,0xC4,
-0xC5,0xC6,0xC7,0xC8,0xC9,0xCA,0xD2,0xD3,0xD4,0xD5,0xD6,0xD7,0xD8,0xD9,0xDA,0xE1,
-0xE2,0xE3,0xE4,0xE5,0xE6,0xE7,0xE8,0xE9,0xEA,0xF1,0xF2,0xF3,0xF4,0xF5,0xF6,0xF7,
-0xF8,0xF9,0xFA,
-};
-
-PROGMEM static uint8_t const std_dht11[179] = {
-0x11,0x00,0x02,0x01,0x02,0x04,0x04,0x03,0x04,0x07,0x05,0x04,0x04,0x00,0x01,0x02,
-0x77,0x00,0x01,0x02,0x03,0x11,0x04,0x05,0x21,0x31,0x06,0x12,0x41,0x51,0x07,0x61,
-0x71,0x13,0x22,0x32,0x81,0x08,0x14,0x42,0x91,0xA1,0xB1,0xC1,0x09,0x23,0x33,0x52,
-0xF0,0x15,0x62,0x72,0xD1,0x0A,0x16,0x24,0x34,0xE1,0x25,0xF1,0x17,0x18,0x19,0x1A,
-0x26,0x27,0x28,0x29,0x2A,0x35,0x36,0x37,0x38,0x39,0x3A,0x43,0x44,0x45,0x46,0x47,
-0x48,0x49,0x4A,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5A,0x63,0x64,0x65,0x66,0x67,
-0x68,0x69,0x6A,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7A,0x82,0x83,0x84,0x85,0x86,
-0x87,0x88,0x89,0x8A,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9A,0xA2,0xA3,0xA4,
-0xA5,0xA6,0xA7,0xA8,0xA9,0xAA,0xB2,0xB3,0xB4,0xB5,0xB6,0xB7,0xB8,0xB9,0xBA,0xC2,
-0xC3,0xC4,0xC5,0xC6,0xC7,0xC8,0xC9,0xCA,0xD2,0xD3,0xD4,0xD5,0xD6,0xD7,0xD8,0xD9,
-0xDA,0xE2,0xE3,0xE4,0xE5,0xE6,0xE7,0xE8,0xE9,0xEA,0xF2,0xF3,0xF4,0xF5,0xF6,0xF7,
-0xF8,0xF9,0xFA,
-};
+/* Standard Huffman tables, and the codes made from them by dhcgen */
+#include "std_dht.h"
+#include "std_dhc.h"
 
 /* Helper for returning the current DHT table */
-#define SDHT (s->sdht[s->acpart ? 1 : 0][s->component ? 1 : 0])
-#define DDHT (s->ddht[s->acpart ? 1 : 0][s->component ? 1 : 0])
+#define SDHL (&s->sdhl[s->acpart ? 1 : 0][s->component ? 1 : 0])
+#define SDHS (s->acpart ? s->sacs[s->component ? 1 : 0] : s->sdcs[s->component ? 1 : 0])
+#define DDHC (s->ddhc[s->acpart ? 1 : 0][s->component ? 1 : 0])
 
-/* Helpers for looking up the current DQT value */
-#define SDQT (s->sdqt[s->component ? 1 : 0][1 + s->acpart])
-#define DDQT (s->ddqt[s->component ? 1 : 0][1 + s->acpart])
+/* Helpers for looking up the current DQT value, and dividing by the
+ * output one. The AVR scales it and reads its reciprocal from PROGMEM
+ * each time, a host has them in tables made at the start of the scan */
+#define SDQT (s->sdqt[s->component ? 1 : 0][s->acpart])
+#ifdef __AVR__
+#define DDQT (ssdv_dqt(s->ddqt[s->component ? 1 : 0], s->quality, s->acpart))
+#define DDIV(i) (rdiv(i, DDQT))
+#else
+#define DDQT (s->dqt[s->component ? 1 : 0][s->acpart])
+#define DDIV(i) (rdiv_rcp(i, DDQT, s->dqt_rcp[s->component ? 1 : 0][s->acpart]))
+#endif
 
 /* Helpers for converting between DQT tables */
-#define AADJ(i) (SDQT == DDQT ? (i) : irdiv(i, DDQT))
+#define AADJ(i) (SDQT == DDQT ? (i) : DDIV(i))
 #define UADJ(i) (SDQT == DDQT ? (i) : (i * SDQT))
-#define BADJ(i) (SDQT == DDQT ? (i) : irdiv(i * SDQT, DDQT))
+#define BADJ(i) (SDQT == DDQT ? (i) : DDIV(i * SDQT))
+
+/* Scale a DQT value for the quality level */
+static inline uint8_t ssdv_dqt_scale(uint16_t v, uint8_t quality)
+{
+	if(quality == SSDV_QUALITY_DEFAULT) return(v);
+	
+	v = (v * pgm_read_byte(&dqt_scale[quality]) + 16) >> 5;
+	return(v < 1 ? 1 : v > 255 ? 255 : v);
+}
+
+/* Read a DQT value from PROGMEM, scaled for the quality level */
+static inline uint8_t ssdv_dqt(const uint8_t *dqt, uint8_t quality, uint8_t i)
+{
+	return(ssdv_dqt_scale(pgm_read_byte(&dqt[1 + i]), quality));
+}
+
+/* Reciprocals for rdiv(), ceil(2^(15 + k) / d) for each divisor d
+ * with k = floor(log2(d)) */
+PROGMEM static uint16_t const rdiv_mul[256] = {
+0x0000,0x8000,0x8000,0x5556,0x8000,0x6667,0x5556,0x4925,0x8000,0x71C8,0x6667,0x5D18,0x5556,0x4EC5,0x4925,0x4445,
+0x8000,0x7879,0x71C8,0x6BCB,0x6667,0x6187,0x5D18,0x590C,0x5556,0x51EC,0x4EC5,0x4BDB,0x4925,0x469F,0x4445,0x4211,
+0x8000,0x7C20,0x7879,0x7508,0x71C8,0x6EB4,0x6BCB,0x6907,0x6667,0x63E8,0x6187,0x5F42,0x5D18,0x5B06,0x590C,0x5727,
+0x5556,0x5398,0x51EC,0x5051,0x4EC5,0x4D49,0x4BDB,0x4A7A,0x4925,0x47DD,0x469F,0x456D,0x4445,0x4326,0x4211,0x4105,
+0x8000,0x7E08,0x7C20,0x7A45,0x7879,0x76BA,0x7508,0x7362,0x71C8,0x7039,0x6EB4,0x6D3B,0x6BCB,0x6A64,0x6907,0x67B3,
+0x6667,0x6523,0x63E8,0x62B3,0x6187,0x6061,0x5F42,0x5E2A,0x5D18,0x5C0C,0x5B06,0x5A06,0x590C,0x5817,0x5727,0x563C,
+0x5556,0x5475,0x5398,0x52C0,0x51EC,0x511C,0x5051,0x4F89,0x4EC5,0x4E05,0x4D49,0x4C90,0x4BDB,0x4B28,0x4A7A,0x49CE,
+0x4925,0x487F,0x47DD,0x473D,0x469F,0x4605,0x456D,0x44D8,0x4445,0x43B4,0x4326,0x429B,0x4211,0x418A,0x4105,0x4082,
+0x8000,0x7F02,0x7E08,0x7D12,0x7C20,0x7B31,0x7A45,0x795D,0x7879,0x7798,0x76BA,0x75DF,0x7508,0x7433,0x7362,0x7293,
+0x71C8,0x70FF,0x7039,0x6F75,0x6EB4,0x6DF6,0x6D3B,0x6C81,0x6BCB,0x6B16,0x6A64,0x69B5,0x6907,0x685C,0x67B3,0x670C,
+0x6667,0x65C4,0x6523,0x6484,0x63E8,0x634D,0x62B3,0x621C,0x6187,0x60F3,0x6061,0x5FD1,0x5F42,0x5EB5,0x5E2A,0x5DA0,
+0x5D18,0x5C91,0x5C0C,0x5B88,0x5B06,0x5A85,0x5A06,0x5988,0x590C,0x5890,0x5817,0x579E,0x5727,0x56B1,0x563C,0x55C8,
+0x5556,0x54E5,0x5475,0x5406,0x5398,0x532B,0x52C0,0x5255,0x51EC,0x5184,0x511C,0x50B6,0x5051,0x4FED,0x4F89,0x4F27,
+0x4EC5,0x4E65,0x4E05,0x4DA7,0x4D49,0x4CEC,0x4C90,0x4C35,0x4BDB,0x4B81,0x4B28,0x4AD1,0x4A7A,0x4A23,0x49CE,0x4979,
+0x4925,0x48D2,0x487F,0x482E,0x47DD,0x478C,0x473D,0x46EE,0x469F,0x4652,0x4605,0x45B9,0x456D,0x4522,0x44D8,0x448E,
+0x4445,0x43FC,0x43B4,0x436D,0x4326,0x42E0,0x429B,0x4255,0x4211,0x41CD,0x418A,0x4147,0x4105,0x40C3,0x4082,0x4041,
+};
+
+PROGMEM static uint8_t const rdiv_shift[256] = {
+0x00,0x00,0x01,0x01,0x02,0x02,0x02,0x02,0x03,0x03,0x03,0x03,0x03,0x03,0x03,0x03,
+0x04,0x04,0x04,0x04,0x04,0x04,0x04,0x04,0x04,0x04,0x04,0x04,0x04,0x04,0x04,0x04,
+0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,
+0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,0x05,
+0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,
+0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,
+0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,
+0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,0x06,
+0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,
+0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,
+0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,
+0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,
+0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,
+0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,
+0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,
+0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,0x07,
+};
 
 /* Integer-only division with rounding */
 static int irdiv(int i, int div)
@@ -114,30 +155,167 @@ static int irdiv(int i, int div)
 	return(i / 2);
 }
 
-static void *dtblcpy(ssdv_t *s, const void *src, size_t n)
+/* The same for a divisor of 1 - 255, by a multiply and shift. The
+ * result is exact for values under RDIV_LIMIT, irdiv() does the rest */
+#define RDIV_LIMIT (0x2000)
+
+#if defined(SSDV_TEST) && !defined(__AVR__)
+/* ssdvtest switches this on to compare against the plain division */
+static char rdiv_exact = 0;
+#endif
+
+static inline int rdiv(int i, uint8_t div)
 {
-	void *r;
-	if(s->dtbl_len + n > TBL_LEN) return(NULL);
-	r = memcpy_P(&s->dtbls[s->dtbl_len], src, n);
-	s->dtbl_len += n;
-	return(r);
+	uint16_t n;
+	uint8_t k;
+	
+#if defined(SSDV_TEST) && !defined(__AVR__)
+	if(rdiv_exact) return(irdiv(i, div));
+#endif
+	
+	if(i >= RDIV_LIMIT || i <= -RDIV_LIMIT) return(irdiv(i, div));
+	
+	n = (i < 0 ? -i : i);
+	k = pgm_read_byte(&rdiv_shift[div]);
+	n = ((uint32_t) n * pgm_read_word(&rdiv_mul[div])) >> 14;
+	n = (n + (1 << k)) >> (k + 1);
+	
+	return(i < 0 ? -(int) n : n);
 }
 
-static uint32_t crc32(void *data, size_t length)
+#ifndef __AVR__
+/* On a host the reciprocal is of twice the divisor, ceil(2^32 / 2d),
+ * and the rounding is in the dividend. It's exact for anything up to
+ * 2^22, well past the largest value times the largest DQT value */
+static inline uint32_t rdiv_rcp_make(uint8_t div)
+{
+	return((uint32_t) (((1ULL << 32) + div * 2 - 1) / (div * 2)));
+}
+
+static inline int rdiv_rcp(int i, uint8_t div, uint32_t rcp)
+{
+	uint32_t n;
+	
+	n = (i < 0 ? -i : i);
+	n = ((uint64_t) (n * 2 + div) * rcp) >> 32;
+	
+#ifdef SSDV_TEST
+	if(rdiv_exact) n = irdiv(i < 0 ? -i : i, div);
+#endif
+	
+	return(i < 0 ? -(int) n : (int) n);
+}
+
+/* Make the output DQT tables for the image's quality, and the
+ * pre-scan's for every quality */
+static void ssdv_dqt_init(ssdv_t *s)
 {
-	uint32_t crc, x;
-	uint8_t i, *d;
+	uint8_t c, i, q;
 	
-	for(d = data, crc = 0xFFFFFFFF; length; length--)
+	for(c = 0; c < 2; c++)
 	{
-		x = (crc ^ *(d++)) & 0xFF;
-		for(i = 8; i > 0; i--)
+		for(i = 0; i < 64; i++)
 		{
-			if(x & 1) x = (x >> 1) ^ 0xEDB88320;
-			else x >>= 1;
+			s->dqt[c][i] = ssdv_dqt(s->ddqt[c], s->quality, i);
+			s->dqt_rcp[c][i] = rdiv_rcp_make(s->dqt[c][i]);
+			
+			if(!s->stats) continue;
+			
+			for(q = 0; q < SSDV_QUALITY_LEVELS; q++)
+			{
+				s->stats->dqt[q][c][i] = ssdv_dqt(s->ddqt[c], q, i);
+				s->stats->rcp[q][c][i] = rdiv_rcp_make(s->stats->dqt[q][c][i]);
+			}
 		}
-		crc = (crc >> 8) ^ x;
 	}
+}
+#endif
+
+/* The natural order position of each zig-zag ordered value */
+PROGMEM static uint8_t const zigzag[64] = {
+ 0, 1, 8,16, 9, 2, 3,10,17,24,32,25,18,11, 4, 5,
+12,19,26,33,40,48,41,34,27,20,13, 6, 7,14,21,28,
+35,42,49,56,57,50,43,36,29,22,15,23,30,37,44,51,
+58,59,52,45,38,31,39,46,53,60,61,54,47,55,62,63,
+};
+
+/* Downscaling matrices. The low frequency n x n corners of (8 / n)^2
+ * blocks, laid side by side, are merged into a single block by M.B.M'.
+ * M is the 8 point DCT of the n point IDCTs, scaled by sqrt(n / 8), in
+ * 2.14 fixed point. The first is for n = 4, the second for n = 2 */
+PROGMEM static int16_t const scale_m4[64] = {
+  8192,     0,     0,     0,  8192,     0,     0,     0,
+  7423,  3406,  -612,   187, -7423,  3406,   612,   187,
+     0,  8192,     0,     0,     0, -8192,     0,     0,
+ -2607,  6480,  4205,  -799,  2607,  6480, -4205,  -799,
+     0,     0,  8192,     0,     0,     0,  8192,     0,
+  1742, -2887,  6293,  4017, -1742, -2887, -6293,  4017,
+     0,     0,     0,  8192,     0,     0,     0, -8192,
+ -1477,  2276, -3075,  7092,  1477,  2276,  3075,  7092,
+};
+
+PROGMEM static int16_t const scale_m2[64] = {
+  4096,     0,  4096,     0,  4096,     0,  4096,     0,
+  5249,   432,  2174,  1044, -2174,  1044, -5249,   432,
+  3784,  1567, -3784,  1567, -3784, -1567,  3784, -1567,
+  1843,  2973, -4450, -1232,  4450, -1232, -1843,  2973,
+     0,  4096,     0, -4096,     0,  4096,     0, -4096,
+ -1232,  4450,  2973, -1843, -2973, -1843,  1232,  4450,
+ -1567,  3784,  1567,  3784,  1567, -3784, -1567, -3784,
+ -1044,  2174,  -432,  5249,   432,  5249,  1044,  2174,
+};
+
+/* CRC32 lookup tables. The AVR has a small table in flash and works
+ * a nibble at a time, a host uses the larger slice-by-8 tables */
+#ifdef __AVR__
+PROGMEM static uint32_t const crc32_table[16] = {
+	0x00000000,0x1DB71064,0x3B6E20C8,0x26D930AC,0x76DC4190,0x6B6B51F4,0x4DB26158,0x5005713C,
+	0xEDB88320,0xF00F9344,0xD6D6A3E8,0xCB61B38C,0x9B64C2B0,0x86D3D2D4,0xA00AE278,0xBDBDF21C,
+};
+
+static inline uint32_t crc32_byte(uint32_t crc, uint8_t b)
+{
+	crc ^= b;
+	crc = (crc >> 4) ^ pgm_read_dword(&crc32_table[crc & 0x0F]);
+	crc = (crc >> 4) ^ pgm_read_dword(&crc32_table[crc & 0x0F]);
+	return(crc);
+}
+#else
+static uint32_t const crc32_table[8][256] = {
+#include "crc32_table.h"
+};
+
+static inline uint32_t crc32_byte(uint32_t crc, uint8_t b)
+{
+	return((crc >> 8) ^ crc32_table[0][(crc ^ b) & 0xFF]);
+}
+#endif
+
+static uint32_t crc32(void *data, size_t length)
+{
+	uint32_t crc;
+	uint8_t *d;
+	
+	d = data;
+	crc = 0xFFFFFFFF;
+	
+#ifndef __AVR__
+	/* Eight bytes at a time */
+	for(; length >= 8; length -= 8, d += 8)
+	{
+		uint32_t a, b;
+		
+		a = crc ^ (d[0] | (d[1] << 8) | (d[2] << 16) | ((uint32_t) d[3] << 24));
+		b = d[4] | (d[5] << 8) | (d[6] << 16) | ((uint32_t) d[7] << 24);
+		
+		crc = crc32_table[7][a & 0xFF] ^ crc32_table[6][(a >> 8) & 0xFF] ^
+		      crc32_table[5][(a >> 16) & 0xFF] ^ crc32_table[4][a >> 24] ^
+		      crc32_table[3][b & 0xFF] ^ crc32_table[2][(b >> 8) & 0xFF] ^
+		      crc32_table[1][(b >> 16) & 0xFF] ^ crc32_table[0][b >> 24];
+	}
+#endif
+	
+	for(; length; length--) crc = crc32_byte(crc, *(d++));
 	
 	return(crc ^ 0xFFFFFFFF);
 }
@@ -163,30 +341,49 @@ static uint32_t encode_callsign(char *callsign)
 	return(x);
 }
 
-static inline char jpeg_dht_lookup(ssdv_t *s, uint8_t *symbol, uint8_t *width)
+static char *decode_callsign(char *callsign, uint32_t code)
 {
-	uint16_t code = 0;
-	uint8_t cw, n;
-	uint8_t *dht, *ss;
+	char *c, s;
 	
-	/* Select the appropriate huffman table */
-	dht = SDHT;
-	ss = &dht[17];
+	*callsign = '\0';
+	
+	/* Is callsign valid? */
+	if(code > 0xF423FFFF) return(callsign);
 	
-	for(cw = 1; cw <= 16; cw++)
+	for(c = callsign; code; c++)
 	{
-		/* Got enough bits? */
-		if(cw > s->worklen) return(SSDV_FEED_ME);
-		
-		/* Compare against each code 'cw' bits wide */
-		for(n = dht[cw]; n > 0; n--)
+		s = code % 40;
+		if(s == 0) *c = '-';
+		else if(s < 11) *c = '0' + s - 1;
+		else if(s < 14) *c = '-';
+		else *c = 'A' + s - 14;
+		code /= 40;
+	}
+	*c = '\0';
+	
+	return(callsign);
+}
+
+static char jpeg_dht_build(ssdv_dht_t *l, uint8_t *symbols)
+{
+	uint16_t code = 0, j;
+	uint8_t cw, n, ss = 0;
+	
+	memset(l->lut, 0, sizeof(l->lut));
+	
+	/* Every code up to DHT_LUT_BITS wide fills all the
+	 * table entries that begin with it */
+	for(cw = 1; cw <= DHT_LUT_BITS; cw++)
+	{
+		for(n = l->count[cw - 1]; n > 0; n--)
 		{
-			if(s->workbits >> (s->worklen - cw) == code)
+			/* Too many codes for this width - bad table */
+			if(code >> cw) return(SSDV_ERROR);
+			
+			for(j = code << (DHT_LUT_BITS - cw); j < (code + 1) << (DHT_LUT_BITS - cw); j++)
 			{
-				/* Found a match */
-				*symbol = *ss;
-				*width = cw;
-				return(SSDV_OK);
+				l->lut[j][0] = symbols[ss];
+				l->lut[j][1] = cw;
 			}
 			ss++; code++;
 		}
@@ -194,40 +391,76 @@ static inline char jpeg_dht_lookup(ssdv_t *s, uint8_t *symbol, uint8_t *width)
 		code <<= 1;
 	}
 	
-	/* No match found - error */
-	return(SSDV_ERROR);
+	/* Where the search for longer codes begins */
+	l->code  = code;
+	l->index = ss;
+	
+	return(SSDV_OK);
 }
 
-static inline char jpeg_dht_lookup_symbol(ssdv_t *s, uint8_t symbol, uint16_t *bits, uint8_t *width)
+static inline char jpeg_dht_lookup(ssdv_t *s, uint8_t *symbol, uint8_t *width)
 {
-	uint16_t code = 0;
-	uint8_t cw, n;
-	uint8_t *dht, *ss;
+	uint16_t code = 0, c;
+	uint8_t cw = 1, n, ss = 0;
+	uint8_t *symbols;
+	ssdv_dht_t *l;
 	
-	dht = DDHT;
-	ss = &dht[17];
+	/* Select the appropriate huffman table */
+	symbols = SDHS;
+	l = SDHL;
 	
-	for(cw = 1; cw <= 16; cw++)
+	if(s->worklen >= DHT_LUT_BITS)
 	{
-		for(n = dht[cw]; n > 0; n--)
+		/* Short codes are found with a single lookup */
+		uint8_t *e = l->lut[(s->workbits >> (s->worklen - DHT_LUT_BITS)) & ((1 << DHT_LUT_BITS) - 1)];
+		
+		if(e[1])
 		{
-			if(*ss == symbol)
-			{
-				/* Found a match */
-				*bits = code;
-				*width = cw;
-				return(SSDV_OK);
-			}
-			ss++; code++;
+			*symbol = e[0];
+			*width = e[1];
+			return(SSDV_OK);
 		}
 		
-		code <<= 1;
+		/* Not in the table, continue with the longer codes */
+		cw   = DHT_LUT_BITS + 1;
+		code = l->code;
+		ss   = l->index;
+	}
+	
+	for(; cw <= 16; cw++)
+	{
+		/* Got enough bits? */
+		if(cw > s->worklen) return(SSDV_FEED_ME);
+		
+		/* The codes 'cw' bits wide are consecutive, test the range */
+		n = l->count[cw - 1];
+		c = s->workbits >> (s->worklen - cw);
+		if(c >= code && (c -= code) < n)
+		{
+			/* Found a match */
+			*symbol = symbols[ss + c];
+			*width = cw;
+			return(SSDV_OK);
+		}
+		
+		ss += n;
+		code = (code + n) << 1;
 	}
 	
 	/* No match found - error */
 	return(SSDV_ERROR);
 }
 
+static inline char jpeg_dht_lookup_symbol(ssdv_t *s, uint8_t symbol, uint16_t *bits, uint8_t *width)
+{
+	const uint8_t *c = &DDHC[symbol * 3];
+	
+	*width = pgm_read_byte(&c[0]);
+	*bits = (pgm_read_byte(&c[1]) << 8) | pgm_read_byte(&c[2]);
+	
+	return(*width ? SSDV_OK : SSDV_ERROR);
+}
+
 static inline int jpeg_int(int bits, int width)
 {
 	int b = (1 << width) - 1;
@@ -249,171 +482,722 @@ static inline void jpeg_encode_int(int value, int *bits, uint8_t *width)
 
 /*****************************************************************************/
 
-static char ssdv_outbits(ssdv_t *s, uint16_t bits, uint8_t length)
+/* Bits are written out a whole byte (AVR) or word (host) at a time
+ * while there's room to spare in the packet. The end of a packet, and
+ * the decoder with its stuffing bytes, go by the slow path instead */
+#ifdef __AVR__
+#define OUTBITS_PUSH (24) /* Most bits in one push, with 7 already waiting */
+#else
+#define OUTBITS_PUSH (32)
+#endif
+
+/* The decoder's JPEG output has a stuffing byte after each 0xFF, but
+ * not the MCUs it records for ssdv_dec_image_jpeg() to put together */
+#ifdef __AVR__
+#define OUT_STUFF(s) ((s)->mode == S_DECODING)
+#else
+#define OUT_STUFF(s) ((s)->mode == S_DECODING && !(s)->mcus)
+#endif
+
+static void ssdv_outbits_slow(ssdv_t *s)
 {
 	uint8_t b;
 	
-	if(length)
-	{
-		s->outbits <<= length;
-		s->outbits |= bits & ((1 << length) - 1);
-		s->outlen += length;
-	}
-	
-	while(s->outlen >= 8 && s->out_len > 0)
+	while(s->outlen >= 8)
 	{
 		b = s->outbits >> (s->outlen - 8);
+		s->outlen -= 8;
+		
+		if(s->out_len == 0)
+		{
+			/* The packet is full. The encoder only finishes packets
+			 * between steps, so keep the byte for the next one. More
+			 * than SPILL_LEN is marked, the packet can't be finished */
+			if(s->mode == S_ENCODING)
+			{
+				if(s->outspill_len < SPILL_LEN) s->outspill[s->outspill_len++] = b;
+				else s->outspill_len = SPILL_LEN + 1;
+			}
+			continue;
+		}
+		
+		/* JPEG output needs a stuffing byte after each 0xFF. If
+		 * there's no room for both, keep the 0xFF for the next buffer */
+		if(OUT_STUFF(s) && b == 0xFF && s->out_len < 2)
+		{
+			s->outlen += 8;
+			s->out_len = 0;
+			break;
+		}
 		
 		/* Put the byte into the output buffer */
 		*(s->outp++) = b;
+		s->out_len--;
+		
+		if(OUT_STUFF(s) && b == 0xFF)
+		{
+			*(s->outp++) = 0x00;
+			s->out_len--;
+		}
+	}
+}
+
+static inline char ssdv_outbits(ssdv_t *s, uint32_t bits, uint8_t length)
+{
+	/* No bits may be set above 'length' */
+	s->outbits <<= length;
+	s->outbits |= bits;
+	s->outlen += length;
+	
+	if(OUT_STUFF(s) || s->outlen / 8 >= s->out_len)
+	{
+		ssdv_outbits_slow(s);
+		return(s->out_len ? SSDV_OK : SSDV_BUFFER_FULL);
+	}
+	
+#ifdef __AVR__
+	while(s->outlen >= 8)
+	{
 		s->outlen -= 8;
+		*(s->outp++) = s->outbits >> s->outlen;
 		s->out_len--;
 	}
+#else
+	if(s->outlen >= 32)
+	{
+		uint32_t w = s->outbits >> (s->outlen - 32);
+		
+		s->outp[0] = w >> 24;
+		s->outp[1] = w >> 16;
+		s->outp[2] = w >> 8;
+		s->outp[3] = w;
+		s->outp    += 4;
+		s->out_len -= 4;
+		s->outlen  -= 32;
+	}
+#endif
 	
-	return(s->out_len ? SSDV_OK : SSDV_BUFFER_FULL);
+	return(SSDV_OK);
 }
 
 static char ssdv_outbits_sync(ssdv_t *s)
 {
 	uint8_t b = s->outlen % 8;
-	if(b) return(ssdv_outbits(s, 0xFF, 8 - b));
-	return(SSDV_OK);
+	
+	/* Pad to a whole byte and write out everything */
+	if(b) ssdv_outbits(s, 0xFF >> b, 8 - b);
+	ssdv_outbits_slow(s);
+	
+	return(s->out_len ? SSDV_OK : SSDV_BUFFER_FULL);
 }
 
+#ifndef __AVR__
+/* The first pass for per-image huffman tables, and tables due to be sent */
+#define HUFF_SCAN(s) ((s)->huff && !((s)->type & SSDV_TYPE_HUFF))
+#define HUFF_DUE(s) ((s)->huff && ((s)->type & SSDV_TYPE_HUFF) && (s)->huff_pos < SSDV_HUFF_LEN)
+#else
+#define HUFF_SCAN(s) (0)
+#define HUFF_DUE(s) (0)
+#endif
+
 static char ssdv_out_jpeg_int(ssdv_t *s, uint8_t rle, int value)
 {
 	uint16_t huffbits = 0;
 	int intbits;
 	uint8_t hufflen = 0, intlen;
 	
+	/* The DC pass leaves out the AC values, the AC pass the DC
+	 * values, grayscale the chroma */
+	if(s->mode == S_ENCODING && (((s->type & SSDV_TYPE_DC) && s->acpart) ||
+	   ((s->type & SSDV_TYPE_AC) && !s->acpart) ||
+	   ((s->type & SSDV_TYPE_GRAY) && s->component)))
+		return(SSDV_OK);
+	
 	jpeg_encode_int(value, &intbits, &intlen);
 	jpeg_dht_lookup_symbol(s, (rle << 4) | (intlen & 0x0F), &huffbits, &hufflen);
 	
+#ifndef __AVR__
+	if(HUFF_SCAN(s))
+		s->huff->freq[s->acpart ? 1 : 0][s->component ? 1 : 0][(rle << 4) | (intlen & 0x0F)]++;
+#endif
+	
+	/* The code and value go together if they fit */
+	if(hufflen + intlen <= OUTBITS_PUSH)
+		return(ssdv_outbits(s, ((uint32_t) huffbits << intlen) | intbits, hufflen + intlen));
+	
 	ssdv_outbits(s, huffbits, hufflen);
-	if(intlen) ssdv_outbits(s, intbits, intlen);
+	return(ssdv_outbits(s, intbits, intlen));
+}
+
+/* Pre-scan statistics. Each value is re-quantised for every quality
+ * level and the length of the codes that would be output added up */
+static void ssdv_stats_code(ssdv_t *s, uint8_t symbol)
+{
+	uint8_t q, w = pgm_read_byte(&DDHC[symbol * 3]);
 	
-	return(SSDV_OK);
+	/* Grayscale images have no chroma */
+	if((s->type & SSDV_TYPE_GRAY) && s->component) return;
+	
+	/* EOB or ZRL, the same at every quality */
+	for(q = 0; q < SSDV_QUALITY_LEVELS; q++)
+	{
+		s->stats->bits[q] += w;
+		if(symbol == 0x00) s->stats->run[q] = 0;
+	}
 }
 
-static char ssdv_process(ssdv_t *s)
+static void ssdv_stats_int(ssdv_t *s, int value)
 {
-	if(s->state == S_HUFF)
+	ssdv_stats_t *st = s->stats;
+	uint8_t c = (s->component ? 1 : 0);
+	uint8_t q, w, rle = 0;
+	int i, bits;
+#ifdef __AVR__
+	uint8_t v = pgm_read_byte(&s->ddqt[c][1 + s->acpart]);
+#endif
+	
+	if((s->type & SSDV_TYPE_GRAY) && s->component) return;
+	
+	for(q = 0; q < SSDV_QUALITY_LEVELS; q++)
 	{
-		uint8_t symbol, width;
-		int r;
+#ifdef __AVR__
+		i = rdiv(value, ssdv_dqt_scale(v, q));
+#else
+		i = rdiv_rcp(value, st->dqt[q][c][s->acpart], st->rcp[q][c][s->acpart]);
+#endif
 		
-		/* Lookup the code, return if error or not enough bits yet */
-		if((r = jpeg_dht_lookup(s, &symbol, &width)) != SSDV_OK)
-			return(r);
-		
-		if(s->acpart == 0) /* DC */
+		if(s->acpart == 0)
 		{
-			if(symbol == 0x00)
-			{
-				/* No change in DC from last block */
-				if(s->reset_mcu == s->mcu_id && (s->mcupart == 0 || s->mcupart >= s->ycparts))
-				{
-					ssdv_out_jpeg_int(s, 0, s->adc[s->component]);
-				}
-				else ssdv_out_jpeg_int(s, 0, 0);
-				
-				/* skip to the next AC part immediately */
-				s->acpart++;
-			}
-			else
-			{
-				/* DC value follows, 'symbol' bits wide */
-				s->state = S_INT;
-				s->needbits = symbol;
-			}
+			/* DC is coded as the difference from the last block */
+			bits = i - st->adc[q][s->component];
+			st->adc[q][s->component] = i;
+			i = bits;
 		}
-		else /* AC */
+		else
 		{
-			s->acrle = 0;
-			if(symbol == 0x00)
-			{
-				/* EOB -- all remaining AC parts are zero */
-				ssdv_out_jpeg_int(s, 0, 0);
-				s->acpart = 64;
-			}
-			else if(symbol == 0xF0)
-			{
-				/* The next 16 AC parts are zero */
-				ssdv_out_jpeg_int(s, 15, 0);
-				s->acpart += 16;
-			}
-			else
+			st->run[q] += s->acrle;
+			
+			/* Zeros are counted until the next value or end of block */
+			if(i == 0 && s->acpart < 63)
 			{
-				/* Next bits are an integer value */
-				s->state = S_INT;
-				s->acrle = symbol >> 4;
-				s->acpart += s->acrle;
-				s->needbits = symbol & 0x0F;
+				st->run[q]++;
+				continue;
 			}
+			
+			if(i == 0) st->run[q] = 0;
+			for(; st->run[q] >= 16; st->run[q] -= 16)
+				st->bits[q] += pgm_read_byte(&DDHC[0xF0 * 3]);
+			
+			rle = st->run[q];
+			st->run[q] = 0;
 		}
 		
-		/* Clear processed bits */
-		s->worklen -= width;
-		s->workbits &= (1 << s->worklen) - 1;
+		jpeg_encode_int(i, &bits, &w);
+		st->bits[q] += pgm_read_byte(&DDHC[((rle << 4) | w) * 3]) + w;
 	}
-	else if(s->state == S_INT)
+}
+
+#ifndef __AVR__
+/* Current output position in bits, for restart interval encoding */
+#define OUTBIT(s) ((uint32_t) ((s)->outp - (s)->out) * 8 + (s)->outlen)
+
+/* Record the first DC code of a component in the MCU, written from 'bit'
+ * on. The stitcher will replace it */
+static void ssdv_mcu_dc(ssdv_t *s, uint32_t bit)
+{
+	ssdv_mcu_t *m = &s->mcus[s->mcu_id];
+	
+	if(s->mcupart == 0)
 	{
-		int i;
-		
-		/* Not enough bits yet? */
-		if(s->worklen < s->needbits) return(SSDV_FEED_ME);
-		
-		/* Decode the integer */
-		i = jpeg_int(s->workbits >> (s->worklen - s->needbits), s->needbits);
-		
-		if(s->acpart == 0) /* DC */
-		{
-			if(s->reset_mcu == s->mcu_id && (s->mcupart == 0 || s->mcupart >= s->ycparts))
-			{
-				/* Output absolute DC value */
-				s->dc[s->component] += UADJ(i);
-				s->adc[s->component] = AADJ(s->dc[s->component]);
-				ssdv_out_jpeg_int(s, 0, s->adc[s->component]);
-			}
-			else
-			{
-				/* Output relative DC value */
-				s->dc[s->component] += UADJ(i);
-				
-				/* Calculate closest adjusted DC value */
-				i = AADJ(s->dc[s->component]);
-				ssdv_out_jpeg_int(s, 0, i - s->adc[s->component]);
-				s->adc[s->component] = i;
-			}
-		}
-		else /* AC */
-		{
-			if((i = BADJ(i)))
-			{
-				s->accrle += s->acrle;
-				while(s->accrle >= 16)
-				{
-					ssdv_out_jpeg_int(s, 15, 0);
-					s->accrle -= 16;
-				}
-				ssdv_out_jpeg_int(s, s->accrle, i);
-				s->accrle = 0;
-			}
-			else
-			{
-				/* AC value got reduced to 0 in the DQT conversion */
-				if(s->acpart >= 63)
-				{
-					ssdv_out_jpeg_int(s, 0, 0);
-					s->accrle = 0;
-				}
-				else s->accrle += s->acrle + 1;
-			}
-		}
-		
+		/* This is the first code of the MCU */
+		m->data = s->out;
+		m->bit  = bit;
+	}
+	
+	m->dc_bit[s->component] = bit - m->bit;
+	m->dc_len[s->component] = OUTBIT(s) - bit;
+	m->adc[s->component] = s->adc[s->component];
+}
+#endif
+
+static void ssdv_set_packet_mcu(ssdv_t *s, uint16_t mcu_id)
+{
+	/* The first MCU of each packet should be byte aligned */
+	ssdv_outbits_sync(s);
+	
+	s->reset_mcu = mcu_id;
+	s->packet_mcu_id = mcu_id;
+	s->packet_mcu_offset = SSDV_PKT_PAYLOAD(s->pkt_size, s->type) - s->out_len + s->outspill_len;
+}
+
+/* Where the DC value of the current block is kept, and its DQT value */
+#define DC_BLOCK(s) ((size_t) (s)->mcu_id * ((s)->ycparts + 2) + (s)->mcupart)
+#define DC_DQT(s) ((s)->dqt[(s)->component ? 1 : 0][0])
+#define DC_RCP(s) ((s)->dqt_rcp[(s)->component ? 1 : 0][0])
+
+/* Output the DC value of a block of the AC pass, kept from the DC pass.
+ * It's coded relative to the last block as usual */
+static void ssdv_dec_dc(ssdv_t *s)
+{
+	int i = 0;
+#ifndef __AVR__
+	uint32_t bit = OUTBIT(s);
+	
+	if(s->dcs) i = rdiv_rcp(s->dcs[DC_BLOCK(s)], DC_DQT(s), DC_RCP(s));
+#endif
+	
+	s->acpart = 0;
+	ssdv_out_jpeg_int(s, 0, i - s->adc[s->component]);
+	s->dc[s->component] = s->adc[s->component] = i;
+	
+#ifndef __AVR__
+	if(s->mcus && (s->mcupart == 0 || s->mcupart >= s->ycparts))
+		ssdv_mcu_dc(s, bit);
+#endif
+}
+
+static void ssdv_out_flat_block(ssdv_t *s)
+{
+	if(s->mcupart < s->ycparts) s->component = 0;
+	else s->component = s->mcupart - s->ycparts + 1;
+	
+	if(s->mode == S_DECODING && (s->type & SSDV_TYPE_AC))
+	{
+		/* The DC pass gave the DC value, followed by EOB */
+		ssdv_dec_dc(s);
+	}
+	else
+	{
+		/* No change in DC from the last block, followed by EOB */
+		s->acpart = 0;
+		ssdv_out_jpeg_int(s, 0, 0);
+#ifndef __AVR__
+		/* There's no DC code for the stitcher to replace, the block
+		 * keeps the value of the last one */
+		if(s->mcus && (s->mcupart == 0 || s->mcupart >= s->ycparts))
+			s->mcus[s->mcu_id].dc_len[s->component] = 0;
+#endif
+	}
+	
+	s->acpart = 1;
+	ssdv_out_jpeg_int(s, 0, 0);
+}
+
+static void ssdv_set_skip(ssdv_t *s)
+{
+	uint8_t xs, ys;
+	uint16_t x, y;
+	
+	if(s->mode != S_ENCODING) return;
+	
+	/* MCUs are 8 or 16 pixels wide and high, the window is in 16s */
+	xs = (s->mcu_mode & 1 ? 3 : 4);
+	ys = (s->mcu_mode & 2 ? 3 : 4);
+	x = ((s->mcu_id % (s->width >> xs)) << xs) >> 4;
+	y = ((s->mcu_id / (s->width >> xs)) << ys) >> 4;
+	
+	s->skip = (x < s->crop_x || x >= s->crop_x + s->crop_w ||
+	           y < s->crop_y || y >= s->crop_y + s->crop_h);
+}
+
+/* Output MCUs across and down a downscaled image. These are 8x8, the
+ * width and height are rounded down to a multiple of 16 */
+#define SCALE_MCUS_X(s) (((s)->crop_w >> (s)->scale) << 1)
+#define SCALE_MCUS_Y(s) (((s)->crop_h >> (s)->scale) << 1)
+
+/* Position of the current source MCU in the window */
+#define SCALE_X(s) ((s)->mcu_id % ((s)->width >> 4) - (s)->crop_x)
+#define SCALE_Y(s) ((s)->mcu_id / ((s)->width >> 4) - (s)->crop_y)
+
+static void ssdv_scale_part(ssdv_t *s)
+{
+	uint16_t x = SCALE_X(s);
+	uint16_t y = SCALE_Y(s);
+	uint8_t n, tx, ty, first;
+	int16_t *b;
+	
+	s->stile = NULL;
+	
+	/* Parts of MCUs cropped from the output are dropped */
+	if(s->skip || (x >> (s->scale - 1)) >= SCALE_MCUS_X(s) ||
+	   (y >> (s->scale - 1)) >= SCALE_MCUS_Y(s)) return;
+	
+	if(s->scale == SSDV_SCALE_HALF)
+	{
+		/* The four Y parts make one block, the chroma is unchanged */
+		b = s->sbuf;
+		n = (s->component ? 8 : 4);
+		tx = (s->component ? 0 : s->mcupart & 1);
+		ty = (s->component ? 0 : s->mcupart >> 1);
+		first = (s->mcupart == 0 || s->component);
+	}
+	else
+	{
+		/* Each group of 2x2 MCUs makes one, kept for a whole row */
+		b = &s->sbuf[((x >> 1) * 3 + s->component) * 64];
+		n = (s->component ? 4 : 2);
+		tx = (s->component ? 0 : s->mcupart & 1) | ((x & 1) << (s->component ? 0 : 1));
+		ty = (s->component ? 0 : s->mcupart >> 1) | ((y & 1) << (s->component ? 0 : 1));
+		first = !(x & 1) && !(y & 1) && (s->mcupart == 0 || s->component);
+	}
+	
+	if(first) memset(b, 0, 64 * sizeof(int16_t));
+	
+	s->stile = &b[ty * n * 8 + tx * n];
+	s->stile_n = n;
+}
+
+static void ssdv_scale_value(ssdv_t *s, int value)
+{
+	uint8_t z;
+	
+	if(s->acpart == 0) ssdv_scale_part(s);
+	if(!s->stile || s->acpart >= 64) return;
+	
+	/* Only the low frequency corner of the part is kept */
+	z = pgm_read_byte(&zigzag[s->acpart]);
+	if((z >> 3) < s->stile_n && (z & 7) < s->stile_n)
+		s->stile[(z >> 3) * 8 + (z & 7)] = value;
+}
+
+static char ssdv_scale_end(ssdv_t *s)
+{
+	uint16_t x = SCALE_X(s);
+	uint16_t y = SCALE_Y(s);
+	
+	if(!s->stile) return(0);
+	
+	if(s->scale == SSDV_SCALE_HALF)
+	{
+		/* Y is complete after the last Y part, Cb and Cr every part */
+		if(s->mcupart < s->ycparts - 1) return(0);
+		s->sblock = s->sbuf;
+		s->sblocks = 1;
+	}
+	else
+	{
+		/* All three are complete after the last part of the group */
+		if(!(x & 1) || !(y & 1) || s->mcupart < s->ycparts + 1) return(0);
+		s->sblock = &s->sbuf[(x >> 1) * 3 * 64];
+		s->sblocks = 3;
+		s->component = 0;
+	}
+	
+	s->acpart = 0;
+	s->acrle = 0;
+	s->accrle = 0;
+	
+	return(1);
+}
+
+static void ssdv_scale_dct(int16_t *b, const int16_t *m)
+{
+	int32_t t[8];
+	uint8_t i, j, k;
+	
+	/* B.M' on the rows, then M.B on the columns */
+	for(i = 0; i < 8; i++)
+	{
+		for(j = 0; j < 8; j++) t[j] = 0;
+		for(k = 0; k < 8; k++)
+		{
+			if(!b[i * 8 + k]) continue;
+			for(j = 0; j < 8; j++)
+				t[j] += (int32_t) b[i * 8 + k] * (int16_t) pgm_read_word(&m[j * 8 + k]);
+		}
+		for(j = 0; j < 8; j++) b[i * 8 + j] = (t[j] + 0x2000) >> 14;
+	}
+	
+	for(i = 0; i < 8; i++)
+	{
+		for(j = 0; j < 8; j++) t[j] = 0;
+		for(k = 0; k < 8; k++)
+		{
+			if(!b[k * 8 + i]) continue;
+			for(j = 0; j < 8; j++)
+				t[j] += (int32_t) b[k * 8 + i] * (int16_t) pgm_read_word(&m[j * 8 + k]);
+		}
+		for(j = 0; j < 8; j++) b[j * 8 + i] = (t[j] + 0x2000) >> 14;
+	}
+}
+
+/* Write out the next code of a downscaled block, returns 1 once
+ * all of the blocks are done */
+static char ssdv_scale_out(ssdv_t *s)
+{
+	int16_t *b = s->sblock;
+	int i = 0;
+	
+	if(s->acpart == 0)
+	{
+		/* The first block of each output MCU may start a packet */
+		if(s->component == 0 && s->packet_mcu_id == 0xFFFF)
+			ssdv_set_packet_mcu(s, s->out_mcu_id);
+		
+		/* Merge the parts, half size chroma is already complete */
+		if(s->scale == SSDV_SCALE_QUARTER)
+			ssdv_scale_dct(b, s->component ? scale_m4 : scale_m2);
+		else if(s->component == 0)
+			ssdv_scale_dct(b, scale_m4);
+		
+		if(s->stats) ssdv_stats_int(s, b[0]);
+		
+		/* The DC value is absolute in the first MCU of a packet */
+		i = DDIV(b[0]);
+		ssdv_out_jpeg_int(s, 0, s->reset_mcu == s->out_mcu_id ? i : i - s->adc[s->component]);
+		s->adc[s->component] = i;
+		
+		s->acpart++;
+		return(0);
+	}
+	
+	/* Find the next AC value that isn't quantised to 0 */
+	for(; s->acpart < 64; s->acpart++, s->accrle++)
+	{
+		if(s->stats) ssdv_stats_int(s, b[pgm_read_byte(&zigzag[s->acpart])]);
+		if((i = DDIV(b[pgm_read_byte(&zigzag[s->acpart])]))) break;
+	}
+	
+	if(i)
+	{
+		/* The output tables have no codes for anything wider */
+		if(i > 1023) i = 1023;
+		if(i < -1023) i = -1023;
+		
+		while(s->accrle >= 16)
+		{
+			ssdv_out_jpeg_int(s, 15, 0);
+			s->accrle -= 16;
+		}
+		ssdv_out_jpeg_int(s, s->accrle, i);
+		s->accrle = 0;
+		
+		if(++s->acpart < 64) return(0);
+	}
+	else ssdv_out_jpeg_int(s, 0, 0); /* EOB */
+	
+	/* End of the block */
+	s->acpart = 0;
+	s->accrle = 0;
+	s->sblock += 64;
+	if(s->component == 2) s->out_mcu_id++;
+	s->component++;
+	
+	return(--s->sblocks == 0);
+}
+
+static char ssdv_process(ssdv_t *s)
+{
+#ifndef __AVR__
+	if(s->mcus) s->stepbit = OUTBIT(s);
+#endif
+	
+	if(s->state == S_HUFF)
+	{
+		uint8_t symbol, width;
+		char dc = 0;
+		int r;
+		
+		if(s->acpart == 0 && s->mode == S_DECODING && (s->type & SSDV_TYPE_AC))
+		{
+			/* The AC pass has no DC codes. The value from the DC pass
+			 * is written once the first AC code of the block is in */
+			s->acpart = 1;
+			dc = 1;
+		}
+		
+		/* Lookup the code, return if error or not enough bits yet */
+		r = jpeg_dht_lookup(s, &symbol, &width);
+		if(dc)
+		{
+			s->acpart = 0;
+			if(r == SSDV_OK)
+			{
+				ssdv_dec_dc(s);
+				s->acpart = 1;
+			}
+		}
+		if(r != SSDV_OK) return(r);
+		
+		if(s->acpart == 0) /* DC */
+		{
+			/* DC value follows, 'symbol' bits wide. A width of 0
+			 * is a value of 0, but is still handled as an integer
+			 * so that absolute and relative DC values are treated
+			 * the same way */
+			s->state = S_INT;
+			s->needbits = symbol;
+		}
+		else if(s->scale || s->skip)
+		{
+			/* Downscaling or outside the crop window, the values
+			 * are only looked at by S_INT */
+			if(symbol == 0x00) s->acpart = 64;
+			else if(symbol == 0xF0) s->acpart += 16;
+			else
+			{
+				s->state = S_INT;
+				s->acpart += symbol >> 4;
+				s->needbits = symbol & 0x0F;
+			}
+		}
+		else if(s->passthrough)
+		{
+			/* The tables match, copy the code and value straight through */
+			uint32_t bits;
+			uint8_t n = width + (symbol & 0x0F);
+			
+			if(s->worklen < n) return(SSDV_FEED_ME);
+			
+			/* Grayscale images leave out the chroma */
+			if(!(s->type & SSDV_TYPE_GRAY) || s->component == 0)
+			{
+				bits = s->workbits >> (s->worklen - n);
+				if(n > OUTBITS_PUSH)
+				{
+					ssdv_outbits(s, bits >> 16, n - 16);
+					ssdv_outbits(s, bits & 0xFFFF, 16);
+				}
+				else ssdv_outbits(s, bits, n);
+			}
+			
+			/* EOB ends the block, any other code moves past its zeros */
+			s->acpart = (symbol == 0x00 ? 64 : s->acpart + (symbol >> 4) + 1);
+			width = n;
+		}
+		else /* AC */
+		{
+			s->acrle = 0;
+			if(symbol == 0x00)
+			{
+				/* EOB -- all remaining AC parts are zero */
+				if(s->stats) ssdv_stats_code(s, symbol);
+				ssdv_out_jpeg_int(s, 0, 0);
+				s->acpart = 64;
+			}
+			else if(symbol == 0xF0)
+			{
+				/* The next 16 AC parts are zero */
+				if(s->stats) ssdv_stats_code(s, symbol);
+				ssdv_out_jpeg_int(s, 15, 0);
+				s->acpart += 16;
+			}
+			else
+			{
+				/* Next bits are an integer value */
+				s->state = S_INT;
+				s->acrle = symbol >> 4;
+				s->acpart += s->acrle;
+				s->needbits = symbol & 0x0F;
+			}
+		}
+		
+		/* Clear processed bits */
+		s->worklen -= width;
+		s->workbits &= (1 << s->worklen) - 1;
+	}
+	else if(s->state == S_INT)
+	{
+		int i;
+		
+		/* Not enough bits yet? */
+		if(s->worklen < s->needbits) return(SSDV_FEED_ME);
+		
+		/* Decode the integer */
+		i = jpeg_int(s->workbits >> (s->worklen - s->needbits), s->needbits);
+		
+		if(s->scale)
+		{
+			/* Keep the dequantised value for the downscaled block */
+			if(s->acpart == 0) i = (s->dc[s->component] += i);
+			ssdv_scale_value(s, i * SDQT);
+		}
+		else if(s->skip)
+		{
+			/* Outside the crop window only the DC value is kept */
+			if(s->acpart == 0) s->dc[s->component] += UADJ(i);
+		}
+		else if(s->acpart == 0) /* DC */
+		{
+			if(s->reset_mcu == s->mcu_id && (s->mcupart == 0 || s->mcupart >= s->ycparts))
+			{
+				if(s->mode == S_DECODING)
+				{
+					/* Input is an absolute DC value, output is relative */
+					s->dc[s->component] = i;
+					ssdv_out_jpeg_int(s, 0, i - s->adc[s->component]);
+					s->adc[s->component] = i;
+				}
+				else
+				{
+					/* Output absolute DC value */
+					s->dc[s->component] += UADJ(i);
+					s->adc[s->component] = AADJ(s->dc[s->component]);
+					ssdv_out_jpeg_int(s, 0, s->adc[s->component]);
+				}
+			}
+			else
+			{
+				/* Output relative DC value */
+				s->dc[s->component] += UADJ(i);
+				
+				/* Calculate closest adjusted DC value */
+				i = AADJ(s->dc[s->component]);
+				ssdv_out_jpeg_int(s, 0, i - s->adc[s->component]);
+				s->adc[s->component] = i;
+			}
+			
+#ifndef __AVR__
+			if(s->mcus && (s->mcupart == 0 || s->mcupart >= s->ycparts))
+				ssdv_mcu_dc(s, s->stepbit);
+#endif
+			
+			/* The DC value is only kept dequantised if the tables differ */
+			if(s->stats)
+				ssdv_stats_int(s, SDQT == DDQT ? s->dc[s->component] * SDQT : s->dc[s->component]);
+		}
+		else /* AC */
+		{
+			if(s->stats) ssdv_stats_int(s, i * SDQT);
+			
+			if((i = BADJ(i)))
+			{
+				s->accrle += s->acrle;
+				while(s->accrle >= 16)
+				{
+					ssdv_out_jpeg_int(s, 15, 0);
+					s->accrle -= 16;
+				}
+				ssdv_out_jpeg_int(s, s->accrle, i);
+				s->accrle = 0;
+			}
+			else
+			{
+				/* AC value got reduced to 0 in the DQT conversion */
+				if(s->acpart >= 63)
+				{
+					ssdv_out_jpeg_int(s, 0, 0);
+					s->accrle = 0;
+				}
+				else s->accrle += s->acrle + 1;
+			}
+		}
+		
 		/* Next AC part to expect */
 		s->acpart++;
 		
+		if(s->mode == S_DECODING && (s->type & SSDV_TYPE_DC))
+		{
+			/* Only the DC value is sent, the AC parts are all zero */
+			ssdv_out_jpeg_int(s, 0, 0);
+			s->acpart = 64;
+			
+#ifndef __AVR__
+			/* Keep it for the AC pass */
+			if(s->dcs) s->dcs[DC_BLOCK(s)] = s->adc[s->component] * DC_DQT(s);
+#endif
+		}
+		
 		/* Next bits are a huffman code */
 		s->state = S_HUFF;
 		
@@ -421,12 +1205,44 @@ static char ssdv_process(ssdv_t *s)
 		s->worklen -= s->needbits;
 		s->workbits &= (1 << s->worklen) - 1;
 	}
+	else if(s->state == S_OUT)
+	{
+		/* Continue writing the downscaled blocks */
+		if(ssdv_scale_out(s)) s->acpart = 64;
+	}
 	
 	if(s->acpart >= 64)
 	{
+		if(s->state == S_OUT) s->state = S_HUFF;
+		else if(s->scale && ssdv_scale_end(s))
+		{
+			/* Write out the blocks this part completes first */
+			s->state = S_OUT;
+			return(s->out_len ? SSDV_OK : SSDV_BUFFER_FULL);
+		}
+		
 		/* Reached the end of this MCU part */
-		if(++s->mcupart == s->ycparts + 2)
+		if(++s->mcupart == s->ycparts && s->mode == S_DECODING && (s->type & SSDV_TYPE_GRAY))
+		{
+			/* Only the Y parts are sent, fill in flat chroma parts */
+			for(; s->mcupart < s->ycparts + 2; s->mcupart++)
+				ssdv_out_flat_block(s);
+		}
+		
+		if(s->mcupart == s->ycparts + 2)
 		{
+#ifndef __AVR__
+			if(s->mcus)
+			{
+				ssdv_mcu_t *m = &s->mcus[s->mcu_id];
+				m->len   = OUTBIT(s) - m->bit;
+				m->tail  = OUTBIT(s) - s->stepbit;
+				m->adc_y = s->adc[0];
+			}
+#endif
+			
+			if(s->mode == S_ENCODING && !s->scale && !s->skip) s->out_mcu_id++;
+			
 			s->mcupart = 0;
 			s->mcu_id++;
 			
@@ -438,22 +1254,21 @@ static char ssdv_process(ssdv_t *s)
 				return(SSDV_EOI);
 			}
 			
-			/* Set the packet MCU marker - encoder only */
-			if(s->packet_mcu_id == 0xFFFF)
+			ssdv_set_skip(s);
+			
+			/* Set the packet MCU marker - encoder only. The reset
+			 * MCU is counted in the source image */
+			if(s->mode == S_ENCODING && !s->scale && !s->skip && s->packet_mcu_id == 0xFFFF)
 			{
-				/* The first MCU of each packet should be byte aligned */
-				ssdv_outbits_sync(s);
-				
+				ssdv_set_packet_mcu(s, s->out_mcu_id);
 				s->reset_mcu = s->mcu_id;
-				s->packet_mcu_id = s->mcu_id;
-				s->packet_mcu_offset = SSDV_PKT_SIZE_PAYLOAD - s->out_len;
 			}
 			
 			/* Test for a reset marker */
 			if(s->dri > 0 && s->mcu_id > 0 && s->mcu_id % s->dri == 0)
 			{
 				s->state = S_MARKER;
-				return(SSDV_FEED_ME);
+				return(s->out_len ? SSDV_FEED_ME : SSDV_BUFFER_FULL);
 			}
 		}
 		
@@ -485,20 +1300,25 @@ static char ssdv_have_marker(ssdv_t *s)
 	case J_SOF0:
 	case J_SOS:
 	case J_DRI:
-	case J_DHT:
-	case J_DQT:
 		/* Copy the data before processing */
-		if(s->marker_len > TBL_LEN + HBUFF_LEN - s->stbl_len)
+		if(s->marker_len > HBUFF_LEN)
 		{
 			/* Not enough memory ... shouldn't happen! */
 			return(SSDV_ERROR);
 		}
 		
-		s->marker_data     = &s->stbls[s->stbl_len];
 		s->marker_data_len = 0;
 		s->state           = S_MARKER_DATA;
 		break;
 	
+	case J_DHT:
+	case J_DQT:
+		/* Tables are read as the data arrives */
+		s->marker_data_len = 0;
+		s->tbl_pos         = 0;
+		s->state           = S_MARKER_DATA;
+		break;
+	
 	case J_SOF2:
 		/* Don't do progressive images! */
 		return(SSDV_ERROR);
@@ -532,10 +1352,115 @@ static char ssdv_have_marker(ssdv_t *s)
 	return(SSDV_OK);
 }
 
-static char ssdv_have_marker_data(ssdv_t *s)
+static char ssdv_have_table_data(ssdv_t *s, uint8_t b)
 {
-	uint8_t *d = s->marker_data;
-	size_t l = s->marker_len;
+	uint8_t c, i;
+	
+	if(s->tbl_pos == 0)
+	{
+		/* Each table begins with its class and ID */
+		s->tbl_id = b;
+		if(s->marker == J_DQT) s->tbl_len = (b >> 4 ? 129 : 65);
+		else s->tbl_len = 17;
+		
+		s->tbl_pos++;
+		return(SSDV_OK);
+	}
+	
+	/* Only 8-bit DQT tables 0 and 1, and DHT tables 0 and 1
+	 * of each class are kept */
+	c = s->tbl_id >> 4;
+	i = s->tbl_id & 0x0F;
+	
+	if(s->marker == J_DQT)
+	{
+		if(s->tbl_id < 2) s->sdqt[i][s->tbl_pos - 1] = b;
+	}
+	else if(s->tbl_pos <= 16)
+	{
+		/* The number of codes of each width */
+		s->tbl_len += b;
+		if((s->tbl_id & 0xEE) == 0)
+		{
+			s->sdhl[c][i].count[s->tbl_pos - 1] = b;
+			if(s->tbl_len - 17 > (c ? DHT_AC_LEN : DHT_DC_LEN))
+				return(SSDV_ERROR);
+		}
+	}
+	else if((s->tbl_id & 0xEE) == 0)
+	{
+		/* The symbols */
+		if(c) s->sacs[i][s->tbl_pos - 17] = b;
+		else s->sdcs[i][s->tbl_pos - 17] = b;
+	}
+	
+	if(++s->tbl_pos < s->tbl_len) return(SSDV_OK);
+	
+	/* The table is complete */
+	s->tbl_pos = 0;
+	
+	if(s->marker == J_DQT)
+	{
+		if(s->tbl_id < 2) s->tbls |= 1 << i;
+	}
+	else if((s->tbl_id & 0xEE) == 0)
+	{
+		/* Build the fast lookup table for this DHT */
+		if(jpeg_dht_build(&s->sdhl[c][i], c ? s->sacs[i] : s->sdcs[i]) != SSDV_OK)
+			return(SSDV_ERROR);
+		
+		s->tbls |= 4 << (c * 2 + i);
+	}
+	
+	return(SSDV_OK);
+}
+
+static char ssdv_dht_match_P(ssdv_dht_t *l, uint8_t *symbols, const uint8_t *dht)
+{
+	uint8_t i, n;
+	
+	/* The codes are the same if the widths and symbols are */
+	for(n = i = 0; i < 16; i++)
+	{
+		if(l->count[i] != pgm_read_byte(&dht[1 + i])) return(0);
+		n += l->count[i];
+	}
+	
+	for(i = 0; i < n; i++)
+		if(symbols[i] != pgm_read_byte(&dht[17 + i])) return(0);
+	
+	return(1);
+}
+
+static char ssdv_enc_passthrough(ssdv_t *s)
+{
+	uint8_t c, i;
+	
+	/* Only plain packets are encoded this way, the AC pass included */
+	if(s->mode != S_ENCODING || s->stats || s->scale || (s->type & SSDV_TYPE_DC))
+		return(0);
+	
+#ifndef __AVR__
+	/* Every code is counted or re-coded with the image's own tables */
+	if(s->huff) return(0);
+#endif
+	
+	/* The AC values must not be re-quantised ... */
+	for(c = 0; c < 2; c++)
+		for(i = 1; i < 64; i++)
+			if(s->sdqt[c][i] != ssdv_dqt(s->ddqt[c], s->quality, i)) return(0);
+	
+	/* ... or re-coded */
+	if(!ssdv_dht_match_P(&s->sdhl[1][0], s->sacs[0], std_dht10)) return(0);
+	if(!ssdv_dht_match_P(&s->sdhl[1][1], s->sacs[1], std_dht11)) return(0);
+	
+	return(1);
+}
+
+static char ssdv_have_marker_data(ssdv_t *s)
+{
+	uint8_t *d = s->marker_data;
+	size_t l = s->marker_len;
 	int i;
 	
 	switch(s->marker)
@@ -591,6 +1516,25 @@ static char ssdv_have_marker_data(ssdv_t *s)
 		
 		s->mcu_count = l;
 		
+		/* The crop window defaults to the whole image */
+		if(s->crop_w == 0)
+		{
+			s->crop_w = s->width >> 4;
+			s->crop_h = s->height >> 4;
+		}
+		
+		if(s->crop_x + s->crop_w > (s->width >> 4) ||
+		   s->crop_y + s->crop_h > (s->height >> 4)) return(SSDV_ERROR);
+		
+		if(s->scale)
+		{
+			/* Downscaling works on 2x2 MCUs, and needs at least one
+			 * output MCU and room for a row of them */
+			if(s->mcu_mode != 0) return(SSDV_ERROR);
+			if(SCALE_MCUS_X(s) == 0 || SCALE_MCUS_Y(s) == 0) return(SSDV_ERROR);
+			if(s->sbuf_len < SSDV_SCALE_LEN(s->width, s->scale)) return(SSDV_ERROR);
+		}
+		
 		break;
 	
 	case J_SOS:
@@ -607,10 +1551,17 @@ static char ssdv_have_marker_data(ssdv_t *s)
 		/* 00 3F 00 */
 		
 		/* Verify all of the DQT and DHT tables where loaded */
-		if(!s->sdqt[0] || !s->sdqt[1]) return(SSDV_ERROR);
+		if(s->tbls != 0x3F) return(SSDV_ERROR);
+		
+#ifndef __AVR__
+		ssdv_dqt_init(s);
+#endif
 		
-		if(!s->sdht[0][0] || !s->sdht[0][1] ||
-		   !s->sdht[1][0] || !s->sdht[1][1]) return(SSDV_ERROR);
+		/* Can the AC codes be copied through? */
+		s->passthrough = ssdv_enc_passthrough(s);
+		
+		/* Is the first MCU in the crop window? */
+		ssdv_set_skip(s);
 		
 		/* The SOS data is followed by the image data */
 		s->state = S_HUFF;
@@ -618,42 +1569,9 @@ static char ssdv_have_marker_data(ssdv_t *s)
 		return(SSDV_OK);
 	
 	case J_DHT:
-		s->stbl_len += l;
-		while(l > 0)
-		{
-			int i, j;
-			
-			switch(d[0])
-			{
-			case 0x00: s->sdht[0][0] = d; break;
-			case 0x01: s->sdht[0][1] = d; break;
-			case 0x10: s->sdht[1][0] = d; break;
-			case 0x11: s->sdht[1][1] = d; break;
-			}
-			
-			/* Skip to the next DHT table */
-			for(j = 17, i = 1; i <= 16; i++)
-				j += d[i];
-			
-			l -= j;
-			d += j;
-		}
-		break;
-	
 	case J_DQT:
-		s->stbl_len += l;
-		while(l > 0)
-		{
-			switch(d[0])
-			{
-			case 0x00: s->sdqt[0] = d; break;
-			case 0x01: s->sdqt[1] = d; break;
-			}
-			
-			/* Skip to the next one, if present */
-			l -= 65;
-			d += 65;
-		}
+		/* The last table was cut short */
+		if(s->tbl_pos != 0) return(SSDV_ERROR);
 		break;
 	
 	case J_DRI:
@@ -665,189 +1583,2023 @@ static char ssdv_have_marker_data(ssdv_t *s)
 	return(SSDV_OK);
 }
 
-char ssdv_enc_init(ssdv_t *s, char *callsign, uint8_t image_id)
+static void ssdv_write_header(ssdv_t *s, uint8_t mcu_offset, uint16_t mcu_id)
 {
-	memset(s, 0, sizeof(ssdv_t));
-	s->image_id = image_id;
-	s->callsign = encode_callsign(callsign);
+	s->out[0]  = 0x55;                /* Sync */
+	s->out[1]  = SSDV_TYPE ^ s->type; /* Type */
+	s->out[2]  = s->callsign >> 24;
+	s->out[3]  = s->callsign >> 16;
+	s->out[4]  = s->callsign >> 8;
+	s->out[5]  = s->callsign;
+	s->out[6]  = s->image_id;         /* Image ID */
+	s->out[7]  = s->packet_id >> 8;   /* Packet ID MSB */
+	s->out[8]  = s->packet_id & 0xFF; /* Packet ID LSB */
+	s->out[9]  = s->crop_w >> s->scale; /* Width / 16 */
+	s->out[10] = s->crop_h >> s->scale; /* Height / 16 */
+	s->out[11] = (s->scale ? 3 : s->mcu_mode & 0x03); /* MCU mode (2 bits) */
+	s->out[11] |= ((SSDV_PKT_SIZE - s->pkt_size) >> 5) << 2; /* Packet size (3 bits) */
+	s->out[11] |= ((s->quality - SSDV_QUALITY_DEFAULT) & 7) << 5; /* Quality (3 bits) */
+	s->out[12] = mcu_offset;          /* Next MCU offset */
+	s->out[13] = mcu_id >> 8;         /* MCU ID MSB */
+	s->out[14] = mcu_id & 0xFF;       /* MCU ID LSB */
+}
+
+static char ssdv_enc_header(ssdv_t *s, char r)
+{
+	uint16_t mcu_id    = s->packet_mcu_id;
+	uint8_t mcu_offset = s->packet_mcu_offset;
 	
-	/* Prepare the output JPEG tables */
-	s->ddqt[0] = dtblcpy(s, std_dqt0, sizeof(std_dqt0));
-	s->ddqt[1] = dtblcpy(s, std_dqt1, sizeof(std_dqt1));
-	s->ddht[0][0] = dtblcpy(s, std_dht00, sizeof(std_dht00));
-	s->ddht[0][1] = dtblcpy(s, std_dht01, sizeof(std_dht01));
-	s->ddht[1][0] = dtblcpy(s, std_dht10, sizeof(std_dht10));
-	s->ddht[1][1] = dtblcpy(s, std_dht11, sizeof(std_dht11));
+	if(r != SSDV_BUFFER_FULL && r != SSDV_EOI) return(SSDV_ERROR);
+	
+	/* Bytes were lost past the end of the packet */
+	if(s->outspill_len > SPILL_LEN) return(SSDV_ERROR);
+	
+	if(mcu_offset != 0xFF && mcu_offset >= SSDV_PKT_PAYLOAD(s->pkt_size, s->type))
+	{
+		/* The first MCU begins in the next packet, not this one */
+		mcu_id = 0xFFFF;
+		mcu_offset = 0xFF;
+		s->packet_mcu_offset -= SSDV_PKT_PAYLOAD(s->pkt_size, s->type);
+	}
+	else
+	{
+		/* Clear the MCU data for the next packet */
+		s->packet_mcu_id = 0xFFFF;
+		s->packet_mcu_offset = 0xFF;
+	}
+	
+	/* A packet is ready, create the headers */
+	ssdv_write_header(s, mcu_offset, mcu_id);
+	s->packet_id++;
+	
+	/* Fill any remaining bytes with noise */
+	if(s->out_len > 0) ssdv_memset_prng(s->outp, s->out_len);
+	
+	/* Have we reached the end of the image data? Any bytes
+	 * that didn't fit go in one more packet first */
+	if(r == SSDV_EOI && s->outspill_len == 0) s->state = S_EOI;
 	
 	return(SSDV_OK);
 }
 
-char ssdv_enc_set_buffer(ssdv_t *s, uint8_t *buffer)
+/* Is b the type byte of base type t, with any flags toggled? */
+#define SSDV_IS_TYPE(b, t) ((((b) ^ (t)) & ~SSDV_TYPE_FLAGS & 0xFF) == 0)
+
+static uint16_t ssdv_pkt_size(uint8_t *packet)
 {
-	s->out     = buffer;
-	s->outp    = buffer + SSDV_PKT_SIZE_HEADER;
-	s->out_len = SSDV_PKT_SIZE_PAYLOAD;
+	/* 256 bytes, less 32 for each step in bits 2-4 of the MCU mode byte */
+	return(SSDV_PKT_SIZE - ((packet[11] >> 2) & 0x07) * 32);
+}
+
+void ssdv_enc_fec(uint8_t *packet)
+{
+	uint16_t l = ssdv_pkt_size(packet);
+	uint8_t t = SSDV_PKT_FLAGS(packet[1]);
+	const rs8_code_t *code = rs8_code(SSDV_PKT_RSCODES(t));
+	uint32_t x;
+	uint8_t i;
+#ifdef SSDV_FUSED_FEC
+	uint8_t *rs = &packet[1 + SSDV_PKT_CRCDATA(l, t) + SSDV_PKT_SIZE_CRC];
 	
-	/* Zero the payload memory */
-	memset(s->out, 0, SSDV_PKT_SIZE);
+	if(t & SSDV_TYPE_NOFEC) x = crc32(&packet[1], SSDV_PKT_CRCDATA(l, t));
+	else
+	{
+		/* Calculate the CRC and RS codes in the same pass over the packet */
+		memset(rs, 0, code->nroots);
+		for(x = 0xFFFFFFFF, i = 1; i < 1 + SSDV_PKT_CRCDATA(l, t); i++)
+		{
+			x = crc32_byte(x, packet[i]);
+			rs8_encode_byte(code, packet[i], rs);
+		}
+		x ^= 0xFFFFFFFF;
+	}
+#else
+	/* Calculate the CRC codes */
+	x = crc32(&packet[1], SSDV_PKT_CRCDATA(l, t));
+#endif
+	i = 1 + SSDV_PKT_CRCDATA(l, t);
 	
-	/* Flush the output bits */
-	ssdv_outbits(s, 0, 0);
+	packet[i++] = (x >> 24) & 0xFF;
+	packet[i++] = (x >> 16) & 0xFF;
+	packet[i++] = (x >> 8) & 0xFF;
+	packet[i++] = x & 0xFF;
 	
-	return(SSDV_OK);
+	/* Without FEC the packet ends with the CRC */
+	if(t & SSDV_TYPE_NOFEC) return;
+	
+#ifdef SSDV_FUSED_FEC
+	/* Finish the RS codes with the CRC */
+	for(i -= SSDV_PKT_SIZE_CRC; i < 1 + SSDV_PKT_CRCDATA(l, t) + SSDV_PKT_SIZE_CRC; i++)
+		rs8_encode_byte(code, packet[i], rs);
+#else
+	/* Generate the RS codes, shortening the code for small packets */
+	rs8_encode(code, &packet[1], &packet[i], SSDV_PKT_SIZE - l);
+#endif
 }
 
-char ssdv_enc_get_packet(ssdv_t *s)
+/* The CRC and RS codes of the image packets are worked out as the bytes
+ * are written, a few after each input byte, so there's little left to do
+ * when a packet is full. The RS codes build up in their place at the end
+ * of the packet, which nothing else touches until then */
+static void ssdv_enc_fec_add(ssdv_t *s, uint8_t end)
 {
-	int r;
-	uint8_t b;
+	const rs8_code_t *code = s->code;
+	uint8_t *rs = &s->out[1 + SSDV_PKT_CRCDATA(s->pkt_size, s->type) + SSDV_PKT_SIZE_CRC];
+	uint32_t x = s->fec_crc;
+	uint8_t i;
 	
-	/* Have we reached the end of the image? */
-	if(s->state == S_EOI) return(SSDV_EOI);
+	for(i = s->fec_len; i < end; i++)
+	{
+		x = crc32_byte(x, s->out[i]);
+		if(code) rs8_encode_byte(code, s->out[i], rs);
+	}
 	
-	/* If the output buffer is empty, re-initialise */
-	if(s->out_len == 0) ssdv_enc_set_buffer(s, s->out);
+	s->fec_crc = x;
+	s->fec_len = end;
+}
+
+static void ssdv_enc_fec_update(ssdv_t *s)
+{
+	uint16_t mcu_id = s->packet_mcu_id;
+	uint8_t mcu_offset = s->packet_mcu_offset;
 	
-	while(s->in_len)
+	if(s->fec_len == 0)
 	{
-		b = *(s->inp++);
-		s->in_len--;
-		
-		/* Skip bytes if necessary */
-		if(s->in_skip) { s->in_skip--; continue; }
+		/* The header isn't known until the first MCU of the packet
+		 * has its place. The scans don't need the codes at all */
+		if(mcu_id == 0xFFFF || s->stats || HUFF_SCAN(s)) return;
 		
-		switch(s->state)
+		/* The same header ssdv_enc_header() will write */
+		if(mcu_offset >= SSDV_PKT_PAYLOAD(s->pkt_size, s->type))
 		{
-		case S_MARKER:
-			s->marker = (s->marker << 8) | b;
-			
-			if(s->marker == J_TEM ||
-			   (s->marker >= J_RST0 && s->marker <= J_EOI))
-			{
-				/* Marker without data */
-				s->marker_len = 0;
-				r = ssdv_have_marker(s);
-				if(r != SSDV_OK) return(r);
-			}
-			else if(s->marker >= J_SOF0 && s->marker <= J_COM)
-			{
-				/* All other markers are followed by data */
-				s->marker_len = 0;
-				s->state = S_MARKER_LEN;
-				s->needbits = 16;
-			}
-			break;
-		
-		case S_MARKER_LEN:
-			s->marker_len = (s->marker_len << 8) | b;
-			if((s->needbits -= 8) == 0)
-			{
-				s->marker_len -= 2;
-				r = ssdv_have_marker(s);
-				if(r != SSDV_OK) return(r);
-			}
-			break;
-		
-		case S_MARKER_DATA:
-			s->marker_data[s->marker_data_len++] = b;
-			if(s->marker_data_len == s->marker_len)
-			{
-				r = ssdv_have_marker_data(s);
-				if(r != SSDV_OK) return(r);
-			}
-			break;
-		
-		case S_HUFF:
-		case S_INT:
-			/* Is the next byte a stuffing byte? Skip it */
-			/* TODO: Test the next byte is actually 0x00 */
-			if(b == 0xFF) s->in_skip++;
-			
-			/* Add the new byte to the work area */
-			s->workbits = (s->workbits << 8) | b;
-			s->worklen += 8;
-			
-			/* Process the new data until more needed, or an error occurs */
-			while((r = ssdv_process(s)) == SSDV_OK);
-			
-			if(r == SSDV_BUFFER_FULL || r == SSDV_EOI)
-			{
-				uint16_t mcu_id       = s->packet_mcu_id;
-				uint8_t i, mcu_offset = s->packet_mcu_offset;
-				uint32_t x;
-				
-				if(mcu_offset != 0xFF && mcu_offset >= SSDV_PKT_SIZE_PAYLOAD)
-				{
-					/* The first MCU begins in the next packet, not this one */
-					mcu_id = 0xFFFF;
-					mcu_offset = 0xFF;
-					s->packet_mcu_offset -= SSDV_PKT_SIZE_PAYLOAD;
-				}
-				else
-				{
-					/* Clear the MCU data for the next packet */
-					s->packet_mcu_id = 0xFFFF;
-					s->packet_mcu_offset = 0xFF;
-				}
-				
-				/* A packet is ready, create the headers */
-				s->out[0]  = 0x55;                /* Sync */
-				s->out[1]  = 0x66;                /* Type */
-				s->out[2]  = s->callsign >> 24;
-				s->out[3]  = s->callsign >> 16;
-				s->out[4]  = s->callsign >> 8;
-				s->out[5]  = s->callsign;
-				s->out[6]  = s->image_id;         /* Image ID */
-				s->out[7]  = s->packet_id >> 8;   /* Packet ID MSB */
-				s->out[8]  = s->packet_id & 0xFF; /* Packet ID LSB */
-				s->out[9]  = s->width >> 4;       /* Width / 16 */
-				s->out[10] = s->height >> 4;      /* Height / 16 */
-				s->out[11] = s->mcu_mode & 0x03;  /* MCU mode (2 bits) */
-				s->out[12] = mcu_offset;          /* Next MCU offset */
-				s->out[13] = mcu_id >> 8;         /* MCU ID MSB */
-				s->out[14] = mcu_id & 0xFF;       /* MCU ID LSB */
-				
-				/* Fill any remaining bytes with noise */
-				if(s->out_len > 0) ssdv_memset_prng(s->outp, s->out_len);
-				
-				/* Calculate the CRC codes */
-				x = crc32(&s->out[1], SSDV_PKT_SIZE_CRCDATA);
-				
-				i = 1 + SSDV_PKT_SIZE_CRCDATA;
-				s->out[i++] = (x >> 24) & 0xFF;
-				s->out[i++] = (x >> 16) & 0xFF;
-				s->out[i++] = (x >> 8) & 0xFF;
-				s->out[i++] = x & 0xFF;
-				
-				/* Generate the RS codes */
-				encode_rs_8(&s->out[1], &s->out[i], 0);
-				
-				s->packet_id++;
-				
-				/* Have we reached the end of the image data? */
-				if(r == SSDV_EOI) s->state = S_EOI;
-				
-				return(SSDV_OK);
-			}
-			else if(r != SSDV_FEED_ME) return(SSDV_ERROR);
-			break;
-		
-		case S_EOI:
-			/* Shouldn't reach this point */
-			break;
+			mcu_id = 0xFFFF;
+			mcu_offset = 0xFF;
 		}
+		
+		ssdv_write_header(s, mcu_offset, mcu_id);
+		s->fec_crc = 0xFFFFFFFF;
+		s->fec_len = 1;
 	}
 	
-	/* Need more data */
-	return(SSDV_FEED_ME);
+	ssdv_enc_fec_add(s, s->outp - s->out);
 }
 
-char ssdv_enc_feed(ssdv_t *s, uint8_t *buffer, size_t length)
+static void ssdv_enc_fec_finish(ssdv_t *s)
 {
-	s->inp    = buffer;
-	s->in_len = length;
+	const rs8_code_t *code = s->code;
+	uint8_t i = 1 + SSDV_PKT_CRCDATA(s->pkt_size, s->type);
+	uint8_t *rs = &s->out[i + SSDV_PKT_SIZE_CRC];
+	uint32_t x;
+	
+	/* A packet with no MCU of its own is done in one go */
+	if(s->fec_len == 0)
+	{
+		ssdv_enc_fec(s->out);
+		return;
+	}
+	
+	/* The rest of the payload, noise included */
+	ssdv_enc_fec_add(s, i);
+	x = s->fec_crc ^ 0xFFFFFFFF;
+	
+	s->out[i++] = (x >> 24) & 0xFF;
+	s->out[i++] = (x >> 16) & 0xFF;
+	s->out[i++] = (x >> 8) & 0xFF;
+	s->out[i++] = x & 0xFF;
+	
+	/* Finish the RS codes with the CRC */
+	if(code)
+		for(i -= SSDV_PKT_SIZE_CRC; i < 1 + SSDV_PKT_CRCDATA(s->pkt_size, s->type) + SSDV_PKT_SIZE_CRC; i++)
+			rs8_encode_byte(code, s->out[i], rs);
+}
+
+/* The parity is a Cauchy code over the field of the RS codes, scaled
+ * so that the first parity packet is the XOR of the group */
+static uint8_t ssdv_parity_coef(uint8_t j, uint8_t k)
+{
+	return(j == 0 ? 1 : rs8_div(k ^ 0xFF, k ^ j ^ 0xFF));
+}
+
+static void ssdv_enc_parity_add(ssdv_t *s)
+{
+	uint8_t j;
+	
+	if(s->par_n == 0) return;
+	
+	/* Everything from the MCU offset to the end of the payload */
+	for(j = 0; j < s->par_m; j++)
+		rs8_muladd(&s->par[j * SSDV_PARITY_ROW(s->pkt_size)], &s->out[12],
+			ssdv_parity_coef(j, s->par_count), 3 + SSDV_PKT_PAYLOAD(s->pkt_size, s->type));
+	
+	/* The parity follows a full group, or the end of the image */
+	if(++s->par_count == s->par_n || s->state == S_EOI) s->par_next = 0;
+}
+
+static char ssdv_enc_parity_packet(ssdv_t *s)
+{
+	uint8_t *p = s->out + SSDV_PKT_SIZE_HEADER;
+	
+	/* Anything already in the buffer goes in the next packet. There's
+	 * nothing after the end of the image, only the last packet */
+	if(s->state != S_EOI)
+	{
+		if(s->outp - p > SPILL_LEN) return(SSDV_ERROR);
+		s->outspill_len = s->outp - p;
+		memcpy(s->outspill, p, s->outspill_len);
+	}
+	s->out_len = 0;
+	
+	/* These don't take a packet ID of their own, the image
+	 * data carries on without a gap between the groups */
+	ssdv_write_header(s, 0, 0);
+	s->out[1]  = SSDV_TYPE_PARITY ^ s->type;
+	s->out[7]  = (s->packet_id - s->par_count) >> 8;
+	s->out[8]  = (s->packet_id - s->par_count) & 0xFF;
+	s->out[9]  = s->par_count;
+	s->out[10] = s->par_next;
+	memcpy(&s->out[12], &s->par[s->par_next * SSDV_PARITY_ROW(s->pkt_size)],
+		3 + SSDV_PKT_PAYLOAD(s->pkt_size, s->type));
+	ssdv_enc_fec(s->out);
+	
+	/* Begin the next group once they're all sent */
+	if(++s->par_next == s->par_m)
+	{
+		s->par_count = 0;
+		memset(s->par, 0, SSDV_PARITY_LEN(s->pkt_size, s->par_m));
+	}
+	
 	return(SSDV_OK);
 }
 
-/*****************************************************************************/
+static char ssdv_enc_packet(ssdv_t *s, char r)
+{
+	if(ssdv_enc_header(s, r) != SSDV_OK) return(SSDV_ERROR);
+	
+	/* The pre-scan only counts the packets, the huffman scan not even that */
+	if(s->stats) s->stats->packets++;
+	else if(!HUFF_SCAN(s))
+	{
+		ssdv_enc_fec_finish(s);
+		ssdv_enc_parity_add(s);
+	}
+	
+#ifndef __AVR__
+	/* Send the tables again after every so many packets */
+	if(s->huff_repeat && ++s->huff_count == s->huff_repeat)
+	{
+		s->huff_count = 0;
+		s->huff_pos = 0;
+	}
+#endif
+	
+	return(SSDV_OK);
+}
+
+#ifndef __AVR__
+/* Per-image huffman tables. Only the DC symbols 0-11, and the AC symbols
+ * for runs of 0-15 zeros and values 1-10 bits long, EOB and ZRL can be
+ * coded. Code lengths are limited to 15 bits so they can be sent in 4 */
+#define HUFF_SYMBOL(ac, x) ((ac) ? (x) == 0x00 || (x) == 0xF0 || \
+	(((x) & 0x0F) >= 1 && ((x) & 0x0F) <= 10) : (x) < 12)
+#define HUFF_MAX_LEN (15)
 
+static void ssdv_huff_lengths(const uint32_t *count, uint8_t *len)
+{
+	uint32_t freq[257], total;
+	uint8_t size[257], bits[33], shift = 0;
+	int16_t others[257];
+	int i, j, c1, c2;
+	
+	/* Keep the total small enough that no code is over 32 bits long
+	 * before the lengths are limited */
+	for(total = i = 0; i < 256; i++) total += count[i];
+	while((total >> shift) > (1UL << 22)) shift++;
+	
+	/* This follows JPEG annex K.2. A reserved symbol with the lowest
+	 * count keeps the all-ones code unused */
+	for(i = 0; i < 256; i++)
+		if((freq[i] = count[i] >> shift) == 0 && count[i]) freq[i] = 1;
+	freq[256] = 1;
+	memset(size, 0, sizeof(size));
+	memset(bits, 0, sizeof(bits));
+	memset(others, 0xFF, sizeof(others));
+	memset(len, 0, 256);
+	
+	while(1)
+	{
+		/* Find the two least frequent symbols left */
+		for(c1 = c2 = -1, i = 0; i < 257; i++)
+		{
+			if(freq[i] == 0) continue;
+			if(c1 < 0 || freq[i] <= freq[c1]) { c2 = c1; c1 = i; }
+			else if(c2 < 0 || freq[i] <= freq[c2]) c2 = i;
+		}
+		if(c2 < 0) break;
+		
+		/* Merge them, each symbol of both branches gets a bit longer */
+		freq[c1] += freq[c2];
+		freq[c2] = 0;
+		
+		for(size[c1]++; others[c1] >= 0; size[c1]++) c1 = others[c1];
+		others[c1] = c2;
+		for(size[c2]++; others[c2] >= 0; size[c2]++) c2 = others[c2];
+	}
+	
+	for(i = 0; i < 257; i++) bits[size[i]]++;
+	bits[0] = 0;
+	
+	/* Nothing to code? */
+	if(size[256] == 0) return;
+	
+	/* Move the longest codes up the tree until they fit */
+	for(i = 32; i > HUFF_MAX_LEN; i--)
+	{
+		while(bits[i] > 0)
+		{
+			for(j = i - 2; bits[j] == 0; j--);
+			
+			bits[i] -= 2;
+			bits[i - 1]++;
+			bits[j + 1] += 2;
+			bits[j]--;
+		}
+	}
+	
+	/* Drop the reserved symbol, it has one of the longest codes */
+	for(; bits[i] == 0; i--);
+	bits[i]--;
+	
+	/* Hand out the lengths, shortest to the symbols that had the shortest */
+	for(i = 1, c1 = 1; i <= 32; i++)
+	{
+		for(j = 0; j < 256; j++)
+		{
+			if(size[j] != i) continue;
+			while(bits[c1] == 0) c1++;
+			bits[c1]--;
+			len[j] = c1;
+		}
+	}
+}
+
+static uint16_t ssdv_huff_dht(const uint8_t *len, uint8_t id, uint8_t *dht)
+{
+	uint16_t n = 17;
+	uint8_t w;
+	int x;
+	
+	/* A DHT table with the symbols in order of length, then value */
+	dht[0] = id;
+	for(w = 1; w <= 16; w++)
+	{
+		dht[w] = 0;
+		for(x = 0; x < 256; x++)
+		{
+			if(len[x] != w) continue;
+			dht[n++] = x;
+			dht[w]++;
+		}
+	}
+	
+	return(n);
+}
+
+static void ssdv_huff_unpack(const uint8_t *data, uint8_t len[2][2][256])
+{
+	uint8_t ac, c;
+	int x, k = 0;
+	
+	memset(len, 0, 2 * 2 * 256);
+	for(ac = 0; ac < 2; ac++)
+		for(c = 0; c < 2; c++)
+			for(x = 0; x < 256; x++)
+				if(HUFF_SYMBOL(ac, x))
+				{
+					len[ac][c][x] = (k & 1 ? data[k >> 1] : data[k >> 1] >> 4) & 0x0F;
+					k++;
+				}
+}
+
+static void ssdv_huff_build(ssdv_huff_t *h)
+{
+	uint8_t len[2][2][256], dht[17 + 256];
+	uint16_t code;
+	uint8_t ac, c, w, n;
+	int x, k = 0;
+	
+	memset(h->data, 0, SSDV_HUFF_LEN);
+	memset(h->dhc, 0, sizeof(h->dhc));
+	
+	/* The first DC value of each packet is coded in full, and these move
+	 * to other MCUs once the codes change length. Every DC symbol gets a
+	 * code in case */
+	for(c = 0; c < 2; c++)
+		for(x = 0; x < 12; x++)
+			if(h->freq[0][c][x] == 0) h->freq[0][c][x] = 1;
+	
+	for(ac = 0; ac < 2; ac++)
+	{
+		for(c = 0; c < 2; c++)
+		{
+			ssdv_huff_lengths(h->freq[ac][c], len[ac][c]);
+			
+			/* Pack the lengths of the symbols that can be coded */
+			for(x = 0; x < 256; x++)
+			{
+				if(!HUFF_SYMBOL(ac, x)) continue;
+				h->data[k >> 1] |= (k & 1 ? len[ac][c][x] : len[ac][c][x] << 4);
+				k++;
+			}
+		}
+	}
+	
+	/* The decoder rebuilds the tables from the data as sent,
+	 * so do the same here */
+	ssdv_huff_unpack(h->data, len);
+	
+	for(ac = 0; ac < 2; ac++)
+	{
+		for(c = 0; c < 2; c++)
+		{
+			ssdv_huff_dht(len[ac][c], 0, dht);
+			
+			/* Codes of each length follow on from the last */
+			for(code = 0, k = 17, w = 1; w <= 16; w++, code <<= 1)
+			{
+				for(n = dht[w]; n > 0; n--, k++, code++)
+				{
+					h->dhc[ac][c][dht[k] * 3]     = w;
+					h->dhc[ac][c][dht[k] * 3 + 1] = code >> 8;
+					h->dhc[ac][c][dht[k] * 3 + 2] = code & 0xFF;
+				}
+			}
+		}
+	}
+}
+
+static char ssdv_enc_huff_packet(ssdv_t *s)
+{
+	uint8_t *p = s->out + SSDV_PKT_SIZE_HEADER;
+	uint8_t n = SSDV_PKT_PAYLOAD(s->pkt_size, s->type);
+	uint8_t pos = s->huff_pos;
+	
+	/* Anything already in the buffer goes in the next packet */
+	if(s->outp - p > SPILL_LEN) return(SSDV_ERROR);
+	s->outspill_len = s->outp - p;
+	memcpy(s->outspill, p, s->outspill_len);
+	
+	if(n > SSDV_HUFF_LEN - pos) n = SSDV_HUFF_LEN - pos;
+	memcpy(p, &s->huff->data[pos], n);
+	s->outp    = p + n;
+	s->out_len = SSDV_PKT_PAYLOAD(s->pkt_size, s->type) - n;
+	s->huff_pos += n;
+	
+	ssdv_write_header(s, SSDV_MCU_TABLES, pos);
+	s->packet_id++;
+	if(s->out_len > 0) ssdv_memset_prng(s->outp, s->out_len);
+	ssdv_enc_fec(s->out);
+	ssdv_enc_parity_add(s);
+	
+	/* Start the next packet afresh */
+	s->out_len = 0;
+	
+	return(SSDV_OK);
+}
+#endif
+
+char ssdv_enc_init(ssdv_t *s, char *callsign, uint8_t image_id, uint16_t pkt_size, uint8_t quality)
+{
+	/* Packets are 64 to 256 bytes long, in steps of 32 */
+	if(pkt_size < SSDV_PKT_SIZE_MIN || pkt_size > SSDV_PKT_SIZE ||
+	   (pkt_size & 0x1F)) return(SSDV_ERROR);
+	if(quality >= SSDV_QUALITY_LEVELS) return(SSDV_ERROR);
+	
+	memset(s, 0, sizeof(ssdv_t));
+	s->image_id = image_id;
+	s->pkt_size = pkt_size;
+	s->quality  = quality;
+	s->callsign = encode_callsign(callsign);
+	s->code     = rs8_code(SSDV_PKT_SIZE_RSCODES);
+	
+	/* Prepare the output JPEG tables */
+	s->ddqt[0] = std_dqt0;
+	s->ddqt[1] = std_dqt1;
+	s->ddhc[0][0] = std_dhc00;
+	s->ddhc[0][1] = std_dhc01;
+	s->ddhc[1][0] = std_dhc10;
+	s->ddhc[1][1] = std_dhc11;
+	
+	return(SSDV_OK);
+}
+
+char ssdv_enc_set_type(ssdv_t *s, uint8_t type)
+{
+	/* Huffman tables and FEC have setters of their own */
+	if((type & ~SSDV_TYPE_FLAGS) || (type & (SSDV_TYPE_HUFF | SSDV_TYPE_FEC)))
+		return(SSDV_ERROR);
+	
+	/* The passes of a progressive image are sent one at a time,
+	 * with the standard tables */
+	if((type & SSDV_TYPE_AC) && (type & SSDV_TYPE_DC)) return(SSDV_ERROR);
+	if((type & (SSDV_TYPE_AC | SSDV_TYPE_DC)) && (s->type & SSDV_TYPE_HUFF)) return(SSDV_ERROR);
+	
+	s->type = (s->type & (SSDV_TYPE_HUFF | SSDV_TYPE_FEC)) | type;
+	return(SSDV_OK);
+}
+
+char ssdv_enc_set_fec(ssdv_t *s, uint8_t fec)
+{
+	uint8_t t = SSDV_TYPE_RS(fec);
+	
+	/* The code must be one rs8gen was asked for */
+	if(!(t & SSDV_TYPE_NOFEC) && !rs8_code(SSDV_PKT_RSCODES(t))) return(SSDV_ERROR);
+	
+	/* This can be changed at any time, but takes effect from the
+	 * start of the next packet, or the next group with parity */
+	s->fec = t;
+	return(SSDV_OK);
+}
+
+char ssdv_enc_set_parity(ssdv_t *s, uint8_t n, uint8_t m, uint8_t *buffer, size_t length)
+{
+	/* Groups of n packets followed by m parity packets, or none if m is 0.
+	 * The code needs n + m to be under 256 */
+	if(m && (n == 0 || n + m > 255 || !buffer ||
+	   length < (size_t) SSDV_PARITY_LEN(s->pkt_size, m))) return(SSDV_ERROR);
+	
+	s->par       = buffer;
+	s->par_n     = (m ? n : 0);
+	s->par_m     = m;
+	s->par_count = 0;
+	s->par_next  = m;
+	if(m) memset(s->par, 0, SSDV_PARITY_LEN(s->pkt_size, m));
+	
+	return(SSDV_OK);
+}
+
+char ssdv_enc_set_scale(ssdv_t *s, uint8_t scale, int16_t *buffer, size_t length)
+{
+	if(scale > SSDV_SCALE_QUARTER) return(SSDV_ERROR);
+	if(scale && !buffer) return(SSDV_ERROR);
+	s->scale    = scale;
+	s->sbuf     = buffer;
+	s->sbuf_len = length;
+	return(SSDV_OK);
+}
+
+char ssdv_enc_set_crop(ssdv_t *s, uint8_t x, uint8_t y, uint8_t width, uint8_t height)
+{
+	if(width == 0 || height == 0) return(SSDV_ERROR);
+	s->crop_x = x;
+	s->crop_y = y;
+	s->crop_w = width;
+	s->crop_h = height;
+	return(SSDV_OK);
+}
+
+char ssdv_enc_prescan(ssdv_t *s, ssdv_stats_t *stats)
+{
+	memset(stats, 0, sizeof(ssdv_stats_t));
+	s->stats = stats;
+	return(SSDV_OK);
+}
+
+uint8_t ssdv_enc_quality(ssdv_t *s, uint16_t packets)
+{
+	ssdv_stats_t *st = s->stats;
+	uint32_t b, n;
+	uint8_t q;
+	
+	/* Bits per packet at the scan quality, headers and padding included */
+	b = st->bits[s->quality] / (st->packets ? st->packets : 1);
+	if(b == 0) b = 1;
+	
+	for(q = SSDV_QUALITY_LEVELS - 1; q > 0; q--)
+	{
+		/* The scan quality is known, the others are estimated */
+		n = (q == s->quality ? st->packets : (st->bits[q] + b - 1) / b);
+		if(n <= packets) break;
+	}
+	
+	return(q);
+}
+
+char ssdv_enc_set_buffer(ssdv_t *s, uint8_t *buffer)
+{
+	/* The payload is longer without FEC. The packets
+	 * of a parity group are all the same length */
+	if(s->par_count == 0 && (s->type & SSDV_TYPE_FEC) != s->fec)
+	{
+		s->type = (s->type & ~SSDV_TYPE_FEC) | s->fec;
+		s->code = rs8_code(SSDV_PKT_RSCODES(s->type));
+	}
+	
+	s->out     = buffer;
+	s->outp    = buffer + SSDV_PKT_SIZE_HEADER;
+	s->out_len = SSDV_PKT_PAYLOAD(s->pkt_size, s->type);
+	
+	/* Zero the payload memory */
+	memset(s->out, 0, s->pkt_size);
+	
+	/* Anything that didn't fit in the last packet goes first */
+	if(s->outspill_len > SPILL_LEN) return(SSDV_ERROR);
+	memcpy(s->outp, s->outspill, s->outspill_len);
+	s->outp    += s->outspill_len;
+	s->out_len -= s->outspill_len;
+	s->outspill_len = 0;
+	s->fec_len = 0;
+	
+	/* Flush the output bits */
+	ssdv_outbits_slow(s);
+	
+	return(SSDV_OK);
+}
+
+char ssdv_enc_get_packet(ssdv_t *s)
+{
+	int r;
+	uint8_t b;
+	
+	/* Have we reached the end of the image, and its last parity? */
+	if(s->state == S_EOI && s->par_next == s->par_m) return(SSDV_EOI);
+	
+	/* If the output buffer is empty, re-initialise */
+	if(s->out_len == 0 && ssdv_enc_set_buffer(s, s->out) != SSDV_OK) return(SSDV_ERROR);
+	
+	/* Parity packets follow the last packet of each group */
+	if(s->par_next < s->par_m) return(ssdv_enc_parity_packet(s));
+	
+#ifndef __AVR__
+	/* Huffman tables only fall due at the start of a packet. They
+	 * can be sent once the image size is known */
+	if(HUFF_DUE(s) && s->mcu_count > 0) return(ssdv_enc_huff_packet(s));
+#endif
+	
+	/* Finish any codes left in the work area by the last packet
+	 * before reading more, or a marker may be taken for data */
+	if(s->state == S_HUFF || s->state == S_INT || s->state == S_OUT)
+	{
+		/* The image is done but for bytes from the last packet */
+		if(s->mcu_id >= s->mcu_count) return(ssdv_enc_packet(s, SSDV_EOI));
+		
+		while((r = ssdv_process(s)) == SSDV_OK);
+		if(r != SSDV_FEED_ME) return(ssdv_enc_packet(s, r));
+	}
+	
+	while(s->in_len)
+	{
+		/* Skip bytes if necessary */
+		if(s->in_skip)
+		{
+			size_t n = (s->in_skip < s->in_len ? s->in_skip : s->in_len);
+			s->inp     += n;
+			s->in_len  -= n;
+			s->in_skip -= n;
+			continue;
+		}
+		
+		b = *(s->inp++);
+		s->in_len--;
+		
+		switch(s->state)
+		{
+		case S_MARKER:
+			s->marker = (s->marker << 8) | b;
+			
+			if(s->marker == J_TEM ||
+			   (s->marker >= J_RST0 && s->marker <= J_EOI))
+			{
+				/* Marker without data */
+				s->marker_len = 0;
+				r = ssdv_have_marker(s);
+				if(r != SSDV_OK) return(r);
+			}
+			else if(s->marker >= J_SOF0 && s->marker <= J_COM)
+			{
+				/* All other markers are followed by data */
+				s->marker_len = 0;
+				s->state = S_MARKER_LEN;
+				s->needbits = 16;
+			}
+			break;
+		
+		case S_MARKER_LEN:
+			s->marker_len = (s->marker_len << 8) | b;
+			if((s->needbits -= 8) == 0)
+			{
+				s->marker_len -= 2;
+				r = ssdv_have_marker(s);
+				if(r != SSDV_OK) return(r);
+			}
+			break;
+		
+		case S_MARKER_DATA:
+			if(s->marker == J_DHT || s->marker == J_DQT)
+			{
+				r = ssdv_have_table_data(s, b);
+				if(r != SSDV_OK) return(r);
+			}
+			else s->marker_data[s->marker_data_len] = b;
+			
+			if(++s->marker_data_len == s->marker_len)
+			{
+				r = ssdv_have_marker_data(s);
+				if(r != SSDV_OK) return(r);
+				
+#ifndef __AVR__
+				/* The tables go before the image data */
+				if(HUFF_DUE(s) && s->state == S_HUFF) return(ssdv_enc_huff_packet(s));
+#endif
+			}
+			break;
+		
+		case S_HUFF:
+		case S_INT:
+		case S_OUT:
+			/* Is the next byte a stuffing byte? Skip it */
+			/* TODO: Test the next byte is actually 0x00 */
+			if(b == 0xFF) s->in_skip++;
+			
+			/* Add the new byte to the work area */
+			s->workbits = (s->workbits << 8) | b;
+			s->worklen += 8;
+			
+			/* Process the new data until more needed, or an error occurs */
+			while((r = ssdv_process(s)) == SSDV_OK);
+			
+			if(r != SSDV_FEED_ME) return(ssdv_enc_packet(s, r));
+			
+			/* Keep the CRC and RS codes up with the output */
+			ssdv_enc_fec_update(s);
+			break;
+		
+		case S_EOI:
+			/* Shouldn't reach this point */
+			break;
+		}
+	}
+	
+	/* Need more data */
+	return(SSDV_FEED_ME);
+}
+
+char ssdv_enc_feed(ssdv_t *s, uint8_t *buffer, size_t length)
+{
+	s->inp    = buffer;
+	s->in_len = length;
+	return(SSDV_OK);
+}
+
+#ifndef __AVR__
+char ssdv_enc_huffscan(ssdv_t *s, ssdv_huff_t *huff)
+{
+	memset(huff->freq, 0, sizeof(huff->freq));
+	s->huff = huff;
+	return(SSDV_OK);
+}
+
+char ssdv_enc_set_huff(ssdv_t *s, ssdv_huff_t *huff, uint16_t repeat)
+{
+	uint8_t ac, c;
+	
+	if(s->type & (SSDV_TYPE_AC | SSDV_TYPE_DC)) return(SSDV_ERROR);
+	
+	ssdv_huff_build(huff);
+	
+	for(ac = 0; ac < 2; ac++)
+		for(c = 0; c < 2; c++)
+			s->ddhc[ac][c] = huff->dhc[ac][c];
+	
+	s->huff = huff;
+	s->huff_repeat = repeat;
+	s->huff_count = 0;
+	s->huff_pos = 0;
+	s->type |= SSDV_TYPE_HUFF;
+	
+	return(SSDV_OK);
+}
+
+char ssdv_enc_segment(ssdv_t *s, uint16_t mcu_id, uint8_t *data, size_t length, uint8_t *buffer, size_t buffer_len, ssdv_mcu_t *mcus)
+{
+	char r = SSDV_FEED_ME;
+	uint8_t b;
+	
+	/* Cropped or downscaled MCUs don't line up with the intervals, and
+	 * the huffman table packets don't fit in with the stitcher */
+	if(s->scale || s->crop_w != (s->width >> 4) || s->crop_h != (s->height >> 4) ||
+	   s->huff) return(SSDV_ERROR);
+	
+	/* Begin at the start of the interval, as after a RST marker */
+	s->mcu_id = mcu_id;
+	s->mcupart = s->acpart = s->component = 0;
+	s->acrle = s->accrle = 0;
+	s->dc[0] = s->dc[1] = s->dc[2] = 0;
+	s->workbits = s->worklen = 0;
+	s->state = S_HUFF;
+	
+	/* The output is a plain bit stream with relative DC values and no
+	 * packet MCU markers; the stitcher sorts those out. Two bytes are
+	 * kept spare as it reads ahead */
+	s->out = s->outp = buffer;
+	s->out_len = buffer_len - 2;
+	s->outbits = s->outlen = 0;
+	s->packet_mcu_id = mcu_id;
+	s->reset_mcu = 0xFFFFFFFF;
+	s->mcus = mcus;
+	
+	while(length-- > 0)
+	{
+		b = *(data++);
+		
+		/* Skip the stuffing byte */
+		if(b == 0xFF && length > 0) { data++; length--; }
+		
+		s->workbits = (s->workbits << 8) | b;
+		s->worklen += 8;
+		
+		while((r = ssdv_process(s)) == SSDV_OK);
+		
+		/* Stop at the end of the interval or image */
+		if(r == SSDV_EOI || s->state == S_MARKER) break;
+		if(r != SSDV_FEED_ME) break;
+	}
+	
+	s->mcus = NULL;
+	
+	if(s->out_len == 0) return(SSDV_BUFFER_FULL);
+	if(r != SSDV_EOI && s->state != S_MARKER) return(SSDV_ERROR);
+	
+	/* Flush any remaining bits */
+	ssdv_outbits_sync(s);
+	
+	return(SSDV_OK);
+}
+
+static char ssdv_stitch_next(ssdv_t *s, size_t *count, size_t max)
+{
+	/* Move on to the next packet once this one is full */
+	if(s->out_len > 0) return(SSDV_OK);
+	
+	ssdv_enc_header(s, SSDV_BUFFER_FULL);
+	if(++(*count) == max) return(SSDV_BUFFER_FULL);
+	
+	ssdv_enc_set_buffer(s, s->out + s->pkt_size);
+	
+	return(SSDV_OK);
+}
+
+static char ssdv_stitch_copy(ssdv_t *s, const uint8_t *data, uint32_t bit, uint32_t len, size_t *count, size_t max)
+{
+	uint32_t w;
+	uint8_t l;
+	
+	for(; len > 0; bit += l, len -= l)
+	{
+		/* Without a count the bits must go in this packet, even if full */
+		if(count && ssdv_stitch_next(s, count, max) != SSDV_OK)
+			return(SSDV_BUFFER_FULL);
+		
+		l = (len > 16 ? 16 : len);
+		data += bit >> 3;
+		bit &= 7;
+		
+		w = (data[0] << 16) | (data[1] << 8) | data[2];
+		ssdv_outbits(s, (w >> (24 - l - bit)) & ((1 << l) - 1), l);
+	}
+	
+	return(SSDV_OK);
+}
+
+char ssdv_enc_stitch(ssdv_t *s, ssdv_mcu_t *mcus, uint8_t *packets, size_t *count)
+{
+	size_t max = *count;
+	ssdv_mcu_t *m;
+	uint32_t bit;
+	uint8_t c;
+	
+	*count = 0;
+	if(max == 0) return(SSDV_BUFFER_FULL);
+	
+	ssdv_enc_set_buffer(s, packets);
+	
+	for(s->mcu_id = 0; s->mcu_id < s->mcu_count;)
+	{
+		m = &mcus[s->mcu_id];
+		
+		/* Copy the MCU, replacing the Y, Cb and Cr DC codes. The first
+		 * MCU of each packet gets absolute values as in the encoder */
+		for(bit = 0, c = 0; c < 3; c++)
+		{
+			if(ssdv_stitch_copy(s, m->data, m->bit + bit, m->dc_bit[c] - bit, count, max) != SSDV_OK ||
+			   ssdv_stitch_next(s, count, max) != SSDV_OK) return(SSDV_BUFFER_FULL);
+			
+			s->component = c;
+			s->acpart = 0;
+			
+			if(s->reset_mcu == s->mcu_id) ssdv_out_jpeg_int(s, 0, m->adc[c]);
+			else ssdv_out_jpeg_int(s, 0, m->adc[c] - s->adc[c]);
+			s->adc[c] = m->adc[c];
+			
+			bit = m->dc_bit[c] + m->dc_len[c];
+		}
+		
+		/* The encoder only finishes a packet between steps, so the
+		 * bits of the last step always go in the current packet */
+		if(ssdv_stitch_copy(s, m->data, m->bit + bit, m->len - m->tail - bit, count, max) != SSDV_OK ||
+		   ssdv_stitch_next(s, count, max) != SSDV_OK) return(SSDV_BUFFER_FULL);
+		ssdv_stitch_copy(s, m->data, m->bit + m->len - m->tail, m->tail, NULL, 0);
+		s->adc[0] = m->adc_y;
+		
+		if(++s->mcu_id >= s->mcu_count)
+		{
+			/* Flush any remaining bits, with one more packet
+			 * for any that didn't fit in this one */
+			ssdv_outbits_sync(s);
+			if(s->outspill_len > 0)
+			{
+				ssdv_enc_header(s, SSDV_BUFFER_FULL);
+				if(++(*count) == max) return(SSDV_BUFFER_FULL);
+				ssdv_enc_set_buffer(s, s->out + s->pkt_size);
+			}
+			if(ssdv_enc_header(s, SSDV_EOI) != SSDV_OK) return(SSDV_ERROR);
+			(*count)++;
+			break;
+		}
+		
+		if(s->packet_mcu_id == 0xFFFF) ssdv_set_packet_mcu(s, s->mcu_id);
+	}
+	
+	return(SSDV_OK);
+}
+#endif
+
+/*****************************************************************************/
+
+static char ssdv_write_marker(ssdv_t *s, uint16_t id, uint16_t length, uint8_t *data)
+{
+	/* Not enough space? */
+	if(s->out_len < (size_t) length + 4) return(SSDV_BUFFER_FULL);
+	
+	*(s->outp++) = id >> 8;
+	*(s->outp++) = id & 0xFF;
+	*(s->outp++) = (length + 2) >> 8;
+	*(s->outp++) = (length + 2) & 0xFF;
+	memcpy(s->outp, data, length);
+	
+	s->outp    += length;
+	s->out_len -= length + 4;
+	
+	return(SSDV_OK);
+}
+
+static char ssdv_write_marker_P(ssdv_t *s, uint16_t id, uint16_t length, const uint8_t *data)
+{
+	/* As above, with the data in PROGMEM */
+	if(s->out_len < (size_t) length + 4) return(SSDV_BUFFER_FULL);
+	
+	*(s->outp++) = id >> 8;
+	*(s->outp++) = id & 0xFF;
+	*(s->outp++) = (length + 2) >> 8;
+	*(s->outp++) = (length + 2) & 0xFF;
+	memcpy_P(s->outp, data, length);
+	
+	s->outp    += length;
+	s->out_len -= length + 4;
+	
+	return(SSDV_OK);
+}
+
+static char ssdv_write_dqt(ssdv_t *s, uint8_t id)
+{
+	/* The decoder's DQT tables, already scaled for the quality */
+	if(s->out_len < 69) return(SSDV_BUFFER_FULL);
+	
+	*(s->outp++) = J_DQT >> 8;
+	*(s->outp++) = J_DQT & 0xFF;
+	*(s->outp++) = 0;
+	*(s->outp++) = 67;
+	*(s->outp++) = id;
+	memcpy(s->outp, s->sdqt[id], 64);
+	
+	s->outp    += 64;
+	s->out_len -= 69;
+	
+	return(SSDV_OK);
+}
+
+static char ssdv_out_headers(ssdv_t *s)
+{
+	uint8_t *b = s->marker_data;
+	
+	/* Start of image */
+	if(s->out_len < 2) return(SSDV_BUFFER_FULL);
+	*(s->outp++) = J_SOI >> 8;
+	*(s->outp++) = J_SOI & 0xFF;
+	s->out_len -= 2;
+	
+	ssdv_write_dqt(s, 0);
+	ssdv_write_dqt(s, 1);
+	
+	/* Build the SOF0 header */
+	b[0]  = 8; /* Precision */
+	b[1]  = s->height >> 8;
+	b[2]  = s->height & 0xFF;
+	b[3]  = s->width >> 8;
+	b[4]  = s->width & 0xFF;
+	b[5]  = 3; /* Components (Y'Cb'Cr) */
+	b[6]  = 1; /* Y */
+	switch(s->mcu_mode)
+	{
+	case 0: b[7] = 0x22; break;
+	case 1: b[7] = 0x12; break;
+	case 2: b[7] = 0x21; break;
+	case 3: b[7] = 0x11; break;
+	}
+	b[8]  = 0x00;
+	b[9]  = 2; /* Cb */
+	b[10] = 0x11;
+	b[11] = 0x01;
+	b[12] = 3; /* Cr */
+	b[13] = 0x11;
+	b[14] = 0x01;
+	ssdv_write_marker(s, J_SOF0, 15, b);
+	
+	ssdv_write_marker_P(s, J_DHT, sizeof(std_dht00), std_dht00);
+	ssdv_write_marker_P(s, J_DHT, sizeof(std_dht01), std_dht01);
+	ssdv_write_marker_P(s, J_DHT, sizeof(std_dht10), std_dht10);
+	ssdv_write_marker_P(s, J_DHT, sizeof(std_dht11), std_dht11);
+	
+	/* Build the SOS header */
+	b[0] = 3; /* Components (Y'Cb'Cr) */
+	b[1] = 1; /* Y */
+	b[2] = 0x00;
+	b[3] = 2; /* Cb */
+	b[4] = 0x11;
+	b[5] = 3; /* Cr */
+	b[6] = 0x11;
+	b[7] = 0x00;
+	b[8] = 0x3F;
+	b[9] = 0x00;
+	
+	return(ssdv_write_marker(s, J_SOS, 10, b));
+}
+
+static void ssdv_fill_gap(ssdv_t *s, uint16_t next_mcu)
+{
+	if(next_mcu > s->mcu_count) next_mcu = s->mcu_count;
+	
+	/* Complete the current block if it was started */
+	if(s->acpart > 0)
+	{
+		/* EOB -- all remaining AC parts are zero */
+		ssdv_out_jpeg_int(s, 0, 0);
+		s->mcupart++;
+	}
+	
+	/* Complete the current MCU if it was started */
+	if(s->mcupart > 0)
+	{
+		for(; s->mcupart < s->ycparts + 2; s->mcupart++)
+			ssdv_out_flat_block(s);
+		
+		s->mcu_id++;
+	}
+	
+	/* Fill any missing MCUs with flat blocks */
+	for(; s->mcu_id < next_mcu; s->mcu_id++)
+	{
+		for(s->mcupart = 0; s->mcupart < s->ycparts + 2; s->mcupart++)
+			ssdv_out_flat_block(s);
+	}
+	
+	/* Decoding continues from the start of the next MCU */
+	s->mcupart = s->acpart = s->component = 0;
+	s->acrle = s->accrle = 0;
+	s->workbits = s->worklen = 0;
+	s->state = S_HUFF;
+}
+
+static void ssdv_load_table_P(ssdv_t *s, uint16_t marker, const uint8_t *tbl, size_t length)
+{
+	/* Read a table from PROGMEM as if it came from a JPEG */
+	s->marker = marker;
+	s->tbl_pos = 0;
+	while(length--) ssdv_have_table_data(s, pgm_read_byte(tbl++));
+}
+
+#ifndef __AVR__
+static char ssdv_dec_huff_packet(ssdv_t *s, ssdv_packet_info_t *p, uint8_t *packet)
+{
+	uint8_t len[2][2][256], dht[17 + 256];
+	uint8_t ac, c, n = SSDV_PKT_PAYLOAD(p->pkt_size, p->type);
+	uint16_t i, pos = p->mcu_id;
+	
+	if(pos >= SSDV_HUFF_LEN) return(SSDV_ERROR);
+	
+	/* The table packets come between the image data */
+	if(p->packet_id == s->packet_id) s->packet_id++;
+	
+	/* Already have the tables? */
+	if(s->huff_ready) return(SSDV_OK);
+	
+	/* The packets can be of any length, with or without FEC,
+	 * so keep track of each byte */
+	if(n > SSDV_HUFF_LEN - pos) n = SSDV_HUFF_LEN - pos;
+	memcpy(&s->huff_data[pos], &packet[SSDV_PKT_SIZE_HEADER], n);
+	for(i = pos; i < pos + n; i++) s->huff_have[i >> 3] |= 1 << (i & 7);
+	
+	for(i = 0; i < SSDV_HUFF_LEN; i++)
+		if(!(s->huff_have[i >> 3] & (1 << (i & 7)))) return(SSDV_OK);
+	
+	/* All there, read them in place of the standard tables */
+	ssdv_huff_unpack(s->huff_data, len);
+	for(ac = 0; ac < 2; ac++)
+		for(c = 0; c < 2; c++)
+			ssdv_load_table_P(s, J_DHT, dht, ssdv_huff_dht(len[ac][c], (ac << 4) | c, dht));
+	s->marker = 0;
+	
+	s->huff_ready = 1;
+	
+	return(SSDV_OK);
+}
+#endif
+
+char ssdv_dec_init(ssdv_t *s)
+{
+	memset(s, 0, sizeof(ssdv_t));
+	s->mode = S_DECODING;
+	
+	/* The packets are encoded with the standard tables,
+	 * the output JPEG uses the same ones */
+	ssdv_load_table_P(s, J_DQT, std_dqt0, sizeof(std_dqt0));
+	ssdv_load_table_P(s, J_DQT, std_dqt1, sizeof(std_dqt1));
+	ssdv_load_table_P(s, J_DHT, std_dht00, sizeof(std_dht00));
+	ssdv_load_table_P(s, J_DHT, std_dht01, sizeof(std_dht01));
+	ssdv_load_table_P(s, J_DHT, std_dht10, sizeof(std_dht10));
+	ssdv_load_table_P(s, J_DHT, std_dht11, sizeof(std_dht11));
+	s->marker = 0;
+	
+	s->ddqt[0] = std_dqt0;
+	s->ddqt[1] = std_dqt1;
+	s->ddhc[0][0] = std_dhc00;
+	s->ddhc[0][1] = std_dhc01;
+	s->ddhc[1][0] = std_dhc10;
+	s->ddhc[1][1] = std_dhc11;
+	
+	return(SSDV_OK);
+}
+
+char ssdv_dec_set_buffer(ssdv_t *s, uint8_t *buffer, size_t length)
+{
+	s->out     = buffer;
+	s->outp    = buffer;
+	s->out_len = length;
+	
+	/* Flush the output bits */
+	ssdv_outbits_slow(s);
+	
+	return(SSDV_OK);
+}
+
+#ifndef __AVR__
+char ssdv_dec_set_dc(ssdv_t *s, int16_t *buffer, size_t length)
+{
+	/* Blocks the DC pass doesn't reach are left mid-gray */
+	memset(buffer, 0, length * sizeof(int16_t));
+	s->dcs     = buffer;
+	s->dcs_len = length;
+	
+	return(SSDV_OK);
+}
+#endif
+
+static char ssdv_dec_begin(ssdv_t *s, ssdv_packet_info_t *p)
+{
+	int i;
+	
+	if(p->mcu_count == 0) return(SSDV_ERROR);
+	
+	s->image_id  = p->image_id;
+	s->width     = p->width;
+	s->height    = p->height;
+	s->mcu_mode  = p->mcu_mode;
+	s->mcu_count = p->mcu_count;
+	s->quality   = p->quality;
+	s->type      = p->type;
+	s->ycparts   = (p->mcu_mode == 0 ? 4 : p->mcu_mode == 3 ? 1 : 2);
+	
+	/* Scale the tables to match the encoder */
+	for(i = 0; i < 64; i++)
+	{
+		s->sdqt[0][i] = ssdv_dqt(s->ddqt[0], s->quality, i);
+		s->sdqt[1][i] = ssdv_dqt(s->ddqt[1], s->quality, i);
+	}
+	
+#ifndef __AVR__
+	ssdv_dqt_init(s);
+	
+	/* Too little room for the DC values is the same as none */
+	if(s->dcs_len < (size_t) s->mcu_count * (s->ycparts + 2)) s->dcs = NULL;
+#endif
+	
+	return(SSDV_OK);
+}
+
+/* The second pass of a progressive image, which follows the DC pass with
+ * the same image ID. The JPEG is begun again, and the DC values kept */
+static char ssdv_dec_pass(ssdv_t *s, ssdv_packet_info_t *p)
+{
+	/* Only the pass can differ */
+	if(((p->type ^ s->type) & ~(SSDV_TYPE_FEC | SSDV_TYPE_AC | SSDV_TYPE_DC)) ||
+	   (s->type & SSDV_TYPE_HUFF) || p->width != s->width ||
+	   p->height != s->height || p->mcu_mode != s->mcu_mode) return(SSDV_ERROR);
+	
+	/* An AC pass is no use without the DC values */
+#ifndef __AVR__
+	if((p->type & SSDV_TYPE_AC) && !s->dcs) return(SSDV_ERROR);
+#else
+	if(p->type & SSDV_TYPE_AC) return(SSDV_ERROR);
+#endif
+	
+	if(ssdv_dec_begin(s, p) != SSDV_OK) return(SSDV_ERROR);
+	
+	s->out_len += s->outp - s->out;
+	s->outp = s->out;
+	s->outbits = s->outlen = 0;
+	s->mcu_id = 0;
+	s->mcupart = s->acpart = s->component = 0;
+	memset(s->dc, 0, sizeof(s->dc));
+	memset(s->adc, 0, sizeof(s->adc));
+	s->state = S_MARKER;
+	
+	return(SSDV_OK);
+}
+
+char ssdv_dec_feed(ssdv_t *s, uint8_t *packet)
+{
+	ssdv_packet_info_t p;
+	int i = 0, r;
+	
+	ssdv_dec_header(&p, packet);
+	
+	/* Parity packets are only of use before decoding, see ssdv_dec_recover() */
+	if(p.parity) return(SSDV_OK);
+	
+	if(s->mcu_count == 0)
+	{
+		/* This is the first packet, begin the image */
+		if(ssdv_dec_begin(s, &p) != SSDV_OK) return(SSDV_ERROR);
+		if(ssdv_out_headers(s) != SSDV_OK) return(SSDV_ERROR);
+		
+		/* Nothing can be decoded before the first MCU */
+		s->packet_id = 0xFFFF;
+	}
+	else if(p.image_id == s->image_id && (s->type & SSDV_TYPE_DC) && !(p.type & SSDV_TYPE_DC))
+	{
+		/* The first packet of the second pass, begin the image again */
+		if(ssdv_dec_pass(s, &p) != SSDV_OK) return(SSDV_ERROR);
+		if(ssdv_out_headers(s) != SSDV_OK) return(SSDV_ERROR);
+		s->packet_id = 0xFFFF;
+	}
+	
+	/* Packets must belong to this image and pass, and arrive in order.
+	 * Each can be sent with any strength of FEC or none */
+	if(p.image_id != s->image_id || ((p.type ^ s->type) & ~SSDV_TYPE_FEC))
+		return(SSDV_ERROR);
+	if(s->packet_id != 0xFFFF && p.packet_id < s->packet_id) return(SSDV_ERROR);
+	
+	/* Ignore anything after the end of the image */
+	if(s->state == S_EOI) return(SSDV_OK);
+	
+#ifndef __AVR__
+	if(p.type & SSDV_TYPE_HUFF)
+	{
+		if(p.mcu_offset == SSDV_MCU_TABLES) return(ssdv_dec_huff_packet(s, &p, packet));
+		
+		/* Nothing can be decoded before the tables arrive */
+		if(!s->huff_ready) return(SSDV_OK);
+	}
+#endif
+	
+	if(p.packet_id != s->packet_id)
+	{
+		/* One or more packets are missing. The data before the
+		 * first new MCU of this packet can't be decoded */
+		if(p.mcu_id == 0xFFFF) return(SSDV_OK);
+		i = p.mcu_offset;
+	}
+	
+	for(; i < SSDV_PKT_PAYLOAD(p.pkt_size, p.type); i++)
+	{
+		if(i == p.mcu_offset)
+		{
+			/* The first new MCU of this packet begins here. Any
+			 * bits left over are padding, or part of a damaged MCU */
+			ssdv_fill_gap(s, p.mcu_id);
+			
+			if(s->mcu_id != p.mcu_id)
+			{
+				/* This MCU has been seen already, the packet is bad */
+				s->packet_id = 0xFFFF;
+				return(SSDV_ERROR);
+			}
+			
+			s->reset_mcu = p.mcu_id;
+		}
+		
+		/* Add the new byte to the work area */
+		s->workbits = (s->workbits << 8) | packet[SSDV_PKT_SIZE_HEADER + i];
+		s->worklen += 8;
+		
+		/* Process the new data until more needed, or an error occurs */
+		while((r = ssdv_process(s)) == SSDV_OK);
+		
+		if(r == SSDV_EOI)
+		{
+			s->state = S_EOI;
+			break;
+		}
+		else if(r != SSDV_FEED_ME) return(SSDV_ERROR);
+	}
+	
+	s->packet_id = p.packet_id + 1;
+	
+	return(SSDV_OK);
+}
+
+char ssdv_dec_get_jpeg(ssdv_t *s, uint8_t **jpeg, size_t *length)
+{
+	ssdv_t t;
+	
+	/* No packets decoded yet? */
+	if(s->mcu_count == 0) return(SSDV_ERROR);
+	
+	/* Complete the image on a copy of the decoder, so that
+	 * decoding can continue when more packets arrive */
+	t = *s;
+	
+	if(t.state != S_EOI)
+	{
+		ssdv_fill_gap(&t, t.mcu_count);
+		ssdv_outbits_sync(&t);
+	}
+	
+	/* End of image */
+	if(t.out_len < 2) return(SSDV_ERROR);
+	*(t.outp++) = J_EOI >> 8;
+	*(t.outp++) = J_EOI & 0xFF;
+	
+	*jpeg   = t.out;
+	*length = t.outp - t.out;
+	
+	return(SSDV_OK);
+}
+
+static char ssdv_dec_check(uint8_t *packet, uint16_t l)
+{
+	uint8_t t = SSDV_PKT_FLAGS(packet[1]);
+	uint32_t x;
+	uint8_t *c;
+	
+	/* Test for a valid header, with no more than one FEC flag */
+	if(!SSDV_IS_TYPE(packet[1], SSDV_TYPE) &&
+	   !SSDV_IS_TYPE(packet[1], SSDV_TYPE_PARITY)) return(SSDV_ERROR);
+	if((t & SSDV_TYPE_FEC) != SSDV_TYPE_RS(SSDV_PKT_RSCODES(t))) return(SSDV_ERROR);
+	if(l < SSDV_PKT_SIZE_MIN) return(SSDV_ERROR);
+	
+	/* Test the checksum */
+	x = crc32(&packet[1], SSDV_PKT_CRCDATA(l, t));
+	c = &packet[1 + SSDV_PKT_CRCDATA(l, t)];
+	
+	if(c[0] != ((x >> 24) & 0xFF) || c[1] != ((x >> 16) & 0xFF) ||
+	   c[2] != ((x >> 8) & 0xFF) || c[3] != (x & 0xFF)) return(SSDV_ERROR);
+	
+	return(SSDV_OK);
+}
+
+char ssdv_dec_is_packet(uint8_t *packet)
+{
+	uint16_t l = ssdv_pkt_size(packet);
+#ifndef __AVR__
+	const rs8_code_t *code;
+	uint8_t t[SSDV_PKT_SIZE];
+#endif
+	
+	if(packet[0] != 0x55) return(SSDV_ERROR);
+	if(ssdv_dec_check(packet, l) == SSDV_OK) return(SSDV_OK);
+	
+#ifndef __AVR__
+	/* Correct what the RS codes can, at the length in the header. The
+	 * packet is left as it was unless the CRC then matches */
+	code = rs8_code(SSDV_PKT_RSCODES(SSDV_PKT_FLAGS(packet[1])));
+	if(code)
+	{
+		memcpy(t, packet, l);
+		if(rs8_decode(code, &t[1], NULL, 0, SSDV_PKT_SIZE - l) > 0 &&
+		   ssdv_dec_check(t, l) == SSDV_OK)
+		{
+			memcpy(packet, t, l);
+			return(SSDV_OK);
+		}
+	}
+#endif
+	
+	return(SSDV_ERROR);
+}
+
+void ssdv_dec_header(ssdv_packet_info_t *info, uint8_t *packet)
+{
+	info->callsign   = ((uint32_t) packet[2] << 24) | ((uint32_t) packet[3] << 16) |
+	                   ((uint32_t) packet[4] << 8) | packet[5];
+	info->image_id   = packet[6];
+	info->packet_id  = (packet[7] << 8) | packet[8];
+	info->pkt_size   = ssdv_pkt_size(packet);
+	info->quality    = ((packet[11] >> 5) + SSDV_QUALITY_DEFAULT) & 7;
+	info->type       = SSDV_PKT_FLAGS(packet[1]);
+	info->parity     = SSDV_IS_TYPE(packet[1], SSDV_TYPE_PARITY);
+	info->width      = packet[9] << 4;
+	info->height     = packet[10] << 4;
+	info->mcu_mode   = packet[11] & 0x03;
+	info->mcu_offset = packet[12];
+	info->mcu_id     = (packet[13] << 8) | packet[14];
+	
+	decode_callsign(info->callsign_s, info->callsign);
+	
+	switch(info->mcu_mode)
+	{
+	case 0: info->mcu_count = (info->width >> 4) * (info->height >> 4); break;
+	case 1: info->mcu_count = (info->width >> 4) * (info->height >> 3); break;
+	case 2: info->mcu_count = (info->width >> 3) * (info->height >> 4); break;
+	case 3: info->mcu_count = (info->width >> 3) * (info->height >> 3); break;
+	}
+}
+
+#ifndef __AVR__
+/* Out of order decoding. Each packet with a new MCU in it begins a run,
+ * which carries on through the packets after it up to the next new MCU
+ * or a missing packet. A run is decoded on its own, as if it came after
+ * a gap, and the MCUs recorded the way the encoder records restart
+ * intervals. They are put together the same way too, replacing the first
+ * DC code of each component.
+ * 
+ * The two passes of a progressive image have runs of their own. The DC
+ * pass fills in the DC values as its runs are decoded, so they go first
+ * and any AC pass runs are decoded again after them */
+#define IMG_PKT(img, id) (&(img)->pkts[(uint32_t) (id) * SSDV_PKT_SIZE])
+
+/* The table packets have their place in the tables where the MCU ID goes */
+static char ssdv_image_tables(ssdv_image_t *img, uint32_t id)
+{
+	uint8_t *x = IMG_PKT(img, id);
+	return((SSDV_PKT_FLAGS(x[1]) & SSDV_TYPE_HUFF) && x[12] == SSDV_MCU_TABLES);
+}
+
+static char ssdv_image_starts(ssdv_image_t *img, uint32_t id)
+{
+	uint8_t *x = IMG_PKT(img, id);
+	
+	if(!img->have[id] || ssdv_image_tables(img, id)) return(0);
+	return(x[13] != 0xFF || x[14] != 0xFF);
+}
+
+static uint16_t ssdv_image_mcu(ssdv_image_t *img, uint32_t id)
+{
+	uint8_t *x = IMG_PKT(img, id);
+	return((x[13] << 8) | x[14]);
+}
+
+/* The packet is part of the DC pass of a progressive image */
+static char ssdv_image_dc(ssdv_image_t *img, uint32_t id)
+{
+	return((SSDV_PKT_FLAGS(IMG_PKT(img, id)[1]) & SSDV_TYPE_DC) != 0);
+}
+
+static char ssdv_image_grow(ssdv_image_t *img, uint16_t id)
+{
+	uint32_t n = (img->count ? img->count : 64);
+	void *p;
+	
+	if(id < img->count) return(SSDV_OK);
+	while(n <= id) n <<= 1;
+	
+	if(!(p = realloc(img->pkts, n * SSDV_PKT_SIZE))) return(SSDV_ERROR);
+	img->pkts = p;
+	if(!(p = realloc(img->have, n))) return(SSDV_ERROR);
+	img->have = p;
+	if(!(p = realloc(img->runs, n * sizeof(ssdv_run_t)))) return(SSDV_ERROR);
+	img->runs = p;
+	if(!(p = realloc(img->todo, n * sizeof(uint16_t)))) return(SSDV_ERROR);
+	img->todo = p;
+	
+	memset(&img->have[img->count], 0, n - img->count);
+	memset(&img->runs[img->count], 0, (n - img->count) * sizeof(ssdv_run_t));
+	img->count = n;
+	
+	return(SSDV_OK);
+}
+
+char ssdv_dec_image_init(ssdv_image_t *img)
+{
+	memset(img, 0, sizeof(ssdv_image_t));
+	return(ssdv_dec_init(&img->s));
+}
+
+char ssdv_dec_image_feed(ssdv_image_t *img, uint8_t *packet)
+{
+	ssdv_packet_info_t p;
+	int32_t i, j;
+	char reach, dc;
+	
+	ssdv_dec_header(&p, packet);
+	
+	/* Parity packets are only of use before decoding, see ssdv_dec_recover() */
+	if(p.parity) return(SSDV_OK);
+	
+	if(img->s.mcu_count == 0)
+	{
+		/* This is the first packet, begin the image */
+		if(ssdv_dec_begin(&img->s, &p) != SSDV_OK) return(SSDV_ERROR);
+		img->s.dcs_len = (size_t) p.mcu_count * (img->s.ycparts + 2);
+		img->mcus = malloc(p.mcu_count * sizeof(ssdv_mcu_t));
+		img->s.dcs = calloc(img->s.dcs_len, sizeof(int16_t));
+		if(!img->mcus || !img->s.dcs)
+		{
+			free(img->mcus);
+			free(img->s.dcs);
+			img->mcus = NULL;
+			img->s.dcs = NULL;
+			img->s.mcu_count = 0;
+			return(SSDV_ERROR);
+		}
+	}
+	
+	/* Packets must belong to this image, each with any strength of FEC */
+	if(p.image_id != img->s.image_id) return(SSDV_ERROR);
+	if((p.type ^ img->s.type) & ~SSDV_TYPE_FEC)
+	{
+		/* Or to the other pass of a progressive image, but without
+		 * per-image tables. The JPEG is made from the second pass
+		 * once any of it arrives */
+		if(((p.type ^ img->s.type) & ~(SSDV_TYPE_FEC | SSDV_TYPE_AC | SSDV_TYPE_DC)) ||
+		   !((p.type ^ img->s.type) & SSDV_TYPE_DC) || (p.type & SSDV_TYPE_HUFF))
+			return(SSDV_ERROR);
+		if(img->s.type & SSDV_TYPE_DC) img->s.type = p.type;
+	}
+	
+	if(ssdv_image_grow(img, p.packet_id) != SSDV_OK) return(SSDV_ERROR);
+	if(img->have[p.packet_id]) return(SSDV_OK);
+	
+	/* Find the run before this packet, and whether it reaches it. The
+	 * packet IDs of the second pass carry on from the DC pass */
+	dc = (p.type & SSDV_TYPE_DC) != 0;
+	for(reach = 1, i = (int32_t) p.packet_id - 1; i >= 0; i--)
+	{
+		if(!img->have[i]) reach = 0;
+		else if(ssdv_image_dc(img, i) != dc) { i = -1; break; }
+		else if(ssdv_image_starts(img, i)) break;
+	}
+	
+	if(p.mcu_id != 0xFFFF && !((p.type & SSDV_TYPE_HUFF) && p.mcu_offset == SSDV_MCU_TABLES))
+	{
+		/* The new MCUs must be in the same order as the packets,
+		 * or the runs could overlap. Any that aren't are bad */
+		for(j = p.packet_id + 1; j < (int32_t) img->count && !ssdv_image_starts(img, j); j++);
+		if(p.mcu_id >= img->s.mcu_count ||
+		   (i >= 0 && ssdv_image_mcu(img, i) >= p.mcu_id) ||
+		   (j < (int32_t) img->count && ssdv_image_dc(img, j) == dc &&
+		    ssdv_image_mcu(img, j) <= p.mcu_id))
+			return(SSDV_ERROR);
+		
+		/* This begins a run, and ends the one before it wherever that is */
+		img->runs[p.packet_id].dirty = 1;
+		reach = 1;
+	}
+	
+	if(i >= 0 && reach) img->runs[i].dirty = 1;
+	
+	memcpy(IMG_PKT(img, p.packet_id), packet, p.pkt_size);
+	img->have[p.packet_id] = 1;
+	
+	/* Nothing can be decoded before the tables arrive */
+	if((p.type & SSDV_TYPE_HUFF) && p.mcu_offset == SSDV_MCU_TABLES)
+		return(ssdv_dec_huff_packet(&img->s, &p, packet));
+	
+	return(SSDV_OK);
+}
+
+uint32_t ssdv_dec_image_runs(ssdv_image_t *img, uint16_t **ids)
+{
+	uint16_t limit = img->s.mcu_count;
+	uint32_t i, k, n = 0;
+	char dc = 0;
+	
+	*ids = img->todo;
+	if((img->s.type & SSDV_TYPE_HUFF) && !img->s.huff_ready) return(0);
+	
+	/* Backwards, so that each run knows where the next one begins */
+	for(i = img->count; i-- > 0;)
+	{
+		if(!ssdv_image_starts(img, i)) continue;
+		
+		/* The last run of the DC pass goes to the end of the image */
+		if(ssdv_image_dc(img, i) != dc)
+		{
+			dc = !dc;
+			limit = img->s.mcu_count;
+		}
+		
+		if(img->runs[i].dirty)
+		{
+			img->runs[i].mcu_limit = limit;
+			img->todo[n++] = i;
+		}
+		
+		limit = ssdv_image_mcu(img, i);
+	}
+	
+	if(img->s.type & SSDV_TYPE_AC)
+	{
+		/* The DC pass runs first, and then every AC pass run again */
+		for(i = k = 0; i < n; i++)
+			if(ssdv_image_dc(img, img->todo[i])) img->todo[k++] = img->todo[i];
+		
+		if(k > 0)
+		{
+			for(i = 0; i < img->count; i++)
+				if(ssdv_image_starts(img, i) && !ssdv_image_dc(img, i))
+					img->runs[i].dirty = 1;
+			n = k;
+		}
+	}
+	
+	return(n);
+}
+
+static char ssdv_image_decode(ssdv_image_t *img, uint16_t id, ssdv_run_t *run)
+{
+	ssdv_packet_info_t p;
+	ssdv_t t = img->s;
+	ssdv_mcu_t *m;
+	uint32_t i;
+	uint16_t o, n;
+	uint8_t *x;
+	char r = SSDV_FEED_ME;
+	
+	ssdv_dec_header(&p, IMG_PKT(img, id));
+	
+	/* Begin at the first new MCU of the packet, as after a gap. The
+	 * output is a plain bit stream with two bytes kept spare, as the
+	 * stitcher reads ahead */
+	t.type = p.type;
+	t.mcus = img->mcus;
+	t.out = t.outp = run->buf;
+	t.out_len = run->buf_len - 2;
+	t.outbits = t.outlen = 0;
+	t.mcu_id = t.reset_mcu = p.mcu_id;
+	t.mcupart = t.acpart = t.component = 0;
+	t.acrle = t.accrle = 0;
+	t.workbits = t.worklen = 0;
+	t.state = S_HUFF;
+	
+	for(i = id, o = p.mcu_offset; i < img->count && img->have[i]; i++, o = 0)
+	{
+		if(ssdv_image_tables(img, i)) continue;
+		if(ssdv_image_dc(img, i) != ssdv_image_dc(img, id)) break;
+		
+		/* The next run begins at the first new MCU of its packet */
+		x = IMG_PKT(img, i);
+		n = SSDV_PKT_PAYLOAD(ssdv_pkt_size(x), SSDV_PKT_FLAGS(x[1]));
+		if(i != id && ssdv_image_starts(img, i)) n = x[12];
+		
+		for(; o < n && t.mcu_id < run->mcu_limit; o++)
+		{
+			t.workbits = (t.workbits << 8) | x[SSDV_PKT_SIZE_HEADER + o];
+			t.worklen += 8;
+			
+			while(t.mcu_id < run->mcu_limit && (r = ssdv_process(&t)) == SSDV_OK);
+			if(r != SSDV_OK && r != SSDV_FEED_ME) break;
+		}
+		
+		if(t.mcu_id >= run->mcu_limit || (r != SSDV_OK && r != SSDV_FEED_ME) ||
+		   (i != id && ssdv_image_starts(img, i))) break;
+	}
+	
+	/* An MCU cut short by a missing packet is finished with flat blocks,
+	 * as ssdv_dec_feed() does */
+	if(r == SSDV_FEED_ME && t.mcu_id < run->mcu_limit && (t.mcupart > 0 || t.acpart > 0))
+	{
+		m = &img->mcus[t.mcu_id];
+		ssdv_fill_gap(&t, t.mcu_id + 1);
+		m->len   = OUTBIT(&t) - m->bit;
+		m->adc_y = t.adc[0];
+	}
+	
+	/* Write out the bits of the last MCU */
+	ssdv_outbits_sync(&t);
+	if(t.out_len == 0) return(SSDV_BUFFER_FULL);
+	
+	run->mcu_end = t.mcu_id;
+	
+	return(r == SSDV_ERROR ? SSDV_ERROR : SSDV_OK);
+}
+
+char ssdv_dec_image_run(ssdv_image_t *img, uint16_t id)
+{
+	ssdv_run_t *run = &img->runs[id];
+	uint8_t *b;
+	size_t l;
+	char r;
+	
+	run->dirty = 0;
+	run->mcu_end = 0;
+	
+	if(!run->buf)
+	{
+		if(!(run->buf = malloc(SSDV_PKT_SIZE * 4))) return(SSDV_ERROR);
+		run->buf_len = SSDV_PKT_SIZE * 4;
+	}
+	
+	while((r = ssdv_image_decode(img, id, run)) == SSDV_BUFFER_FULL)
+	{
+		/* Try again with more room */
+		l = run->buf_len * 2;
+		if(!(b = realloc(run->buf, l))) return(SSDV_ERROR);
+		run->buf = b;
+		run->buf_len = l;
+	}
+	
+	return(r);
+}
+
+static void ssdv_image_copy(ssdv_t *s, ssdv_mcu_t *m)
+{
+	uint32_t bit;
+	uint8_t c;
+	
+	/* Copy the MCU, making its DC codes relative to the last MCU */
+	for(bit = 0, c = 0; c < 3; c++)
+	{
+		if(m->dc_len[c] == 0) continue;
+		
+		ssdv_stitch_copy(s, m->data, m->bit + bit, m->dc_bit[c] - bit, NULL, 0);
+		
+		s->component = c;
+		s->acpart = 0;
+		ssdv_out_jpeg_int(s, 0, m->adc[c] - s->adc[c]);
+		s->adc[c] = m->adc[c];
+		
+		bit = m->dc_bit[c] + m->dc_len[c];
+	}
+	
+	ssdv_stitch_copy(s, m->data, m->bit + bit, m->len - bit, NULL, 0);
+	s->adc[0] = m->adc_y;
+}
+
+char ssdv_dec_image_jpeg(ssdv_image_t *img, uint8_t *buffer, size_t *length)
+{
+	ssdv_run_t *run;
+	uint16_t *ids;
+	uint32_t i, n;
+	ssdv_t t;
+	
+	/* No packets yet? */
+	if(img->s.mcu_count == 0) return(SSDV_ERROR);
+	
+	/* Decode any runs the caller hasn't, the DC pass first */
+	while((n = ssdv_dec_image_runs(img, &ids)) > 0)
+		for(; n > 0; n--) ssdv_dec_image_run(img, ids[n - 1]);
+	
+	t = img->s;
+	t.out = t.outp = buffer;
+	t.out_len = *length;
+	t.outbits = t.outlen = 0;
+	if(ssdv_out_headers(&t) != SSDV_OK) return(SSDV_BUFFER_FULL);
+	
+	/* The runs of the latest pass in order, with flat blocks wherever
+	 * there are none. In the AC pass these have the DC pass values */
+	for(i = 0; i < img->count; i++)
+	{
+		if(!ssdv_image_starts(img, i)) continue;
+		if(ssdv_image_dc(img, i) != ((t.type & SSDV_TYPE_DC) != 0)) continue;
+		
+		run = &img->runs[i];
+		if(run->dirty) continue;
+		
+		ssdv_fill_gap(&t, ssdv_image_mcu(img, i));
+		for(; t.mcu_id < run->mcu_end; t.mcu_id++)
+			ssdv_image_copy(&t, &img->mcus[t.mcu_id]);
+	}
+	
+	ssdv_fill_gap(&t, t.mcu_count);
+	ssdv_outbits_sync(&t);
+	
+	/* End of image */
+	if(t.out_len < 2) return(SSDV_BUFFER_FULL);
+	*(t.outp++) = J_EOI >> 8;
+	*(t.outp++) = J_EOI & 0xFF;
+	
+	*length = t.outp - t.out;
+	
+	return(SSDV_OK);
+}
+
+void ssdv_dec_image_free(ssdv_image_t *img)
+{
+	uint32_t i;
+	
+	for(i = 0; i < img->count; i++) free(img->runs[i].buf);
+	free(img->pkts);
+	free(img->have);
+	free(img->runs);
+	free(img->todo);
+	free(img->mcus);
+	free(img->s.dcs);
+	
+	memset(img, 0, sizeof(ssdv_image_t));
+}
+
+#undef IMG_PKT
+#endif
+
+#ifndef __AVR__
+#define SLOT(id) (&packets[(uint32_t) (id) * l])
+#define A(i, j) (a[(i) * r + (j)])
+
+static int ssdv_recover_group(uint8_t *packets, uint16_t l, uint8_t *have, uint16_t count, uint8_t *parity, uint16_t parity_count, uint8_t *hdr, uint16_t first, uint8_t n, uint8_t *a)
+{
+	uint8_t e[255], *q[255], t[SSDV_PKT_SIZE];
+	uint8_t r = 0, i, j, k, f;
+	uint16_t id, b, len;
+	uint8_t *x;
+	
+	if(first + n > count) return(0);
+	
+	/* The lost packets of the group */
+	for(k = 0; k < n; k++) if(!have[first + k]) e[r++] = k;
+	if(r == 0) return(0);
+	
+	/* Are there enough different parity packets to rebuild them? */
+	for(i = 0, id = 0; i < r && id < parity_count; id++)
+	{
+		x = &parity[(uint32_t) id * l];
+		if(!SSDV_IS_TYPE(x[1], SSDV_TYPE_PARITY) || ssdv_pkt_size(x) != l ||
+		   ((x[7] << 8) | x[8]) != first || x[9] != n) continue;
+		for(j = 0; j < i && q[j][10] != x[10]; j++);
+		if(j == i) q[i++] = x;
+	}
+	if(i < r) return(0);
+	
+	/* All the same length, with or without FEC */
+	len = 3 + SSDV_PKT_PAYLOAD(l, SSDV_PKT_FLAGS(q[0][1]));
+	
+	/* Take the packets that did arrive away from the parity, leaving a sum
+	 * of the lost packets in each of their slots. a is the sums, r by r */
+	for(i = 0; i < r; i++)
+	{
+		x = SLOT(first + e[i]);
+		memcpy(&x[12], &q[i][12], len);
+		
+		for(k = 0; k < n; k++)
+			if(have[first + k])
+				rs8_muladd(&x[12], &SLOT(first + k)[12], ssdv_parity_coef(q[i][10], k), len);
+		
+		for(j = 0; j < r; j++) A(i, j) = ssdv_parity_coef(q[i][10], e[j]);
+	}
+	
+	/* Solve for the lost packets, row i ends up as lost packet i */
+	for(i = 0; i < r; i++)
+	{
+		for(j = i; j < r && A(j, i) == 0; j++);
+		if(j == r) return(0);
+		
+		if(j != i)
+		{
+			memcpy(t, &A(i, 0), r);
+			memcpy(&A(i, 0), &A(j, 0), r);
+			memcpy(&A(j, 0), t, r);
+			memcpy(t, &SLOT(first + e[i])[12], len);
+			memcpy(&SLOT(first + e[i])[12], &SLOT(first + e[j])[12], len);
+			memcpy(&SLOT(first + e[j])[12], t, len);
+		}
+		
+		/* Scale the row so the pivot is 1 ... */
+		x = &SLOT(first + e[i])[12];
+		if((f = A(i, i)) != 1)
+		{
+			for(k = 0; k < r; k++) A(i, k) = rs8_div(A(i, k), f);
+			for(b = 0; b < len; b++) x[b] = rs8_div(x[b], f);
+		}
+		
+		/* ... and take it from the others */
+		for(j = 0; j < r; j++)
+		{
+			if(j == i || (f = A(j, i)) == 0) continue;
+			for(k = 0; k < r; k++) A(j, k) ^= rs8_mul(f, A(i, k));
+			rs8_muladd(&SLOT(first + e[j])[12], x, f, len);
+		}
+	}
+	
+	/* Put the headers back together */
+	for(i = 0; i < r; i++)
+	{
+		id = first + e[i];
+		x = SLOT(id);
+		memcpy(x, hdr, 12);
+		x[1]  = SSDV_TYPE ^ SSDV_PKT_FLAGS(q[0][1]);
+		x[7]  = id >> 8;
+		x[8]  = id & 0xFF;
+		x[11] = q[0][11];
+		ssdv_enc_fec(x);
+		have[id] = 1;
+	}
+	
+	return(r);
+}
+
+#undef SLOT
+#undef A
+
+int ssdv_dec_recover(uint8_t *packets, uint16_t pkt_size, uint8_t *have, uint16_t count, uint8_t *parity, uint16_t parity_count)
+{
+	uint8_t *x, *a, *hdr = NULL;
+	uint16_t id;
+	int r = 0;
+	
+	/* The lost packets take the width and height from any other */
+	for(id = 0; id < count && !hdr; id++)
+		if(have[id]) hdr = &packets[(uint32_t) id * pkt_size];
+	if(!hdr) return(0);
+	
+	/* The sums to solve, for up to 255 lost packets in a group */
+	if(!(a = malloc(255 * 255))) return(0);
+	
+	/* Try each group that has parity. Once rebuilt there's nothing
+	 * lost, so it doesn't matter how many of its parity packets came */
+	for(id = 0; id < parity_count; id++)
+	{
+		x = &parity[(uint32_t) id * pkt_size];
+		if(!SSDV_IS_TYPE(x[1], SSDV_TYPE_PARITY) || ssdv_pkt_size(x) != pkt_size) continue;
+		r += ssdv_recover_group(packets, pkt_size, have, count, parity, parity_count,
+			hdr, (x[7] << 8) | x[8], x[9], a);
+	}
+	
+	free(a);
+	
+	return(r);
+}
+#endif
+
+/*****************************************************************************/
+
+/* The ring's head and tail run up to twice the number of slots,
+ * so that a full ring can be told from an empty one */
+static uint8_t *ssdv_ring_slot(ssdv_ring_t *r, uint8_t i)
+{
+	if(i >= r->slots) i -= r->slots;
+	return(&r->buf[i * r->pkt_size]);
+}
+
+static uint8_t ssdv_ring_step(ssdv_ring_t *r, uint8_t i)
+{
+	return(++i == r->slots * 2 ? 0 : i);
+}
+
+char ssdv_ring_init(ssdv_ring_t *r, uint8_t *buffer, uint8_t slots, uint16_t pkt_size)
+{
+	if(slots == 0 || slots > 127) return(SSDV_ERROR);
+	r->buf      = buffer;
+	r->slots    = slots;
+	r->pkt_size = pkt_size;
+	r->head     = 0;
+	r->tail     = 0;
+	return(SSDV_OK);
+}
+
+uint8_t *ssdv_ring_next(ssdv_ring_t *r)
+{
+	uint8_t head = r->head, tail = r->tail;
+	uint8_t used = (head >= tail ? head - tail : head + r->slots * 2 - tail);
+	
+	if(used == r->slots) return(NULL);
+	return(ssdv_ring_slot(r, head));
+}
+
+void ssdv_ring_push(ssdv_ring_t *r)
+{
+	r->head = ssdv_ring_step(r, r->head);
+}
+
+uint8_t *ssdv_ring_peek(ssdv_ring_t *r)
+{
+	uint8_t tail = r->tail;
+	
+	if(r->head == tail) return(NULL);
+	return(ssdv_ring_slot(r, tail));
+}
+
+void ssdv_ring_pop(ssdv_ring_t *r)
+{
+	r->tail = ssdv_ring_step(r, r->tail);
+}
+
+/*****************************************************************************/
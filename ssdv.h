@@ -17,6 +17,7 @@
 /* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
 #include <stdint.h>
+#include "rs8.h"
 
 #ifndef INC_SSDV_H
 #define INC_SSDV_H
@@ -28,28 +29,163 @@
 #define SSDV_BUFFER_FULL (3)
 #define SSDV_EOI         (4)
 
-/* Packet details */
+/* Packet details. Packets can be 64 to 256 bytes long in steps
+ * of 32, SSDV_PKT_SIZE is the largest */
 #define SSDV_PKT_SIZE         (0x100)
+#define SSDV_PKT_SIZE_MIN     (0x40)
 #define SSDV_PKT_SIZE_HEADER  (0x0F)
 #define SSDV_PKT_SIZE_CRC     (0x04)
 #define SSDV_PKT_SIZE_RSCODES (0x20)
 #define SSDV_PKT_SIZE_PAYLOAD (SSDV_PKT_SIZE - SSDV_PKT_SIZE_HEADER - SSDV_PKT_SIZE_CRC - SSDV_PKT_SIZE_RSCODES)
-#define SSDV_PKT_SIZE_CRCDATA (SSDV_PKT_SIZE_HEADER + SSDV_PKT_SIZE_PAYLOAD - 1)
 
-#define TBL_LEN (546) /* Maximum size of the DQT and DHT tables */
-#define HBUFF_LEN (16) /* Extra space for reading marker data */
+/* The same for a packet of length l and type flags t, which may have
+ * fewer RS codes or none */
+#define SSDV_PKT_RSCODES(t)   ((t) & SSDV_TYPE_NOFEC ? 0 : (t) & SSDV_TYPE_RS8 ? 8 : \
+                               (t) & SSDV_TYPE_RS16 ? 16 : SSDV_PKT_SIZE_RSCODES)
+#define SSDV_PKT_PAYLOAD(l, t) ((l) - SSDV_PKT_SIZE_HEADER - SSDV_PKT_SIZE_CRC - SSDV_PKT_RSCODES(t))
+#define SSDV_PKT_CRCDATA(l, t) (SSDV_PKT_SIZE_HEADER + SSDV_PKT_PAYLOAD(l, t) - 1)
 
+/* Packet types, 0x66 with any of these flags toggled */
+#define SSDV_TYPE       (0x66)
+#define SSDV_TYPE_NOFEC (0x01) /* No RS codes, their space carries image data */
+#define SSDV_TYPE_RS16  (0x20) /* 16 RS codes in place of 32, the rest carries image data */
+#define SSDV_TYPE_RS8   (0x40) /* 8 RS codes */
+#define SSDV_TYPE_AC    (0x04) /* AC values only, the second pass of a progressive image */
+#define SSDV_TYPE_DC    (0x08) /* DC values only, the first pass of a progressive image */
+#define SSDV_TYPE_GRAY  (0x10) /* Y values only, the decoder fills in flat chroma */
+#define SSDV_TYPE_HUFF  (0x80) /* Huffman tables made for the image, sent first */
+#define SSDV_TYPE_FEC   (SSDV_TYPE_NOFEC | SSDV_TYPE_RS16 | SSDV_TYPE_RS8)
+#define SSDV_TYPE_FLAGS (SSDV_TYPE_FEC | SSDV_TYPE_AC | SSDV_TYPE_DC | SSDV_TYPE_GRAY | SSDV_TYPE_HUFF)
+
+/* The flags of a packet's type byte b, and the FEC flags for n RS codes */
+#define SSDV_PKT_FLAGS(b) (((b) ^ SSDV_TYPE) & SSDV_TYPE_FLAGS)
+#define SSDV_TYPE_RS(n)   ((n) == 0 ? SSDV_TYPE_NOFEC : (n) == 8 ? SSDV_TYPE_RS8 : \
+                           (n) == 16 ? SSDV_TYPE_RS16 : 0)
+
+/* The huffman tables go in packets of their own, marked by this MCU
+ * offset and with the position of the data in place of the MCU ID. The
+ * data is a 4-bit code length for each of the 12 DC and 162 AC symbols
+ * of the Y and C tables, 0 for unused symbols */
+#define SSDV_MCU_TABLES (0xFE)
+#define SSDV_HUFF_LEN   (174)
+
+/* Erasure parity packets can follow each group of n packets, and any of
+ * the group lost can be rebuilt if as many parity packets arrive. Their
+ * type is 0x64 with the flags of the group, so older decoders skip them.
+ * The packet ID is that of the first packet of the group, byte 9 holds n
+ * and byte 10 the index of the parity packet. The MCU offset and ID and
+ * the payload hold the parity of the same bytes of the group.
+ * SSDV_PARITY_LEN() is the encoder's work space for m of them */
+#define SSDV_TYPE_PARITY  (0x64)
+#define SSDV_PARITY_ROW(l) ((l) - SSDV_PKT_SIZE_HEADER - SSDV_PKT_SIZE_CRC + 3)
+#define SSDV_PARITY_LEN(l, m) ((m) * SSDV_PARITY_ROW(l))
+
+/* Quality levels, 0 (smallest) to 7 (best). The default level uses the
+ * standard tables, the others scale them */
+#define SSDV_QUALITY_LEVELS  (8)
+#define SSDV_QUALITY_DEFAULT (4)
+
+/* The image can be scaled down to half or quarter size while encoding.
+ * The work buffer holds one block at half size, and a row of MCUs at
+ * quarter size. SSDV_SCALE_LEN() is its length for an image width */
+#define SSDV_SCALE_FULL    (0)
+#define SSDV_SCALE_HALF    (1)
+#define SSDV_SCALE_QUARTER (2)
+#define SSDV_SCALE_LEN(w, scale) ((scale) == SSDV_SCALE_QUARTER ? 3 * 64 * ((w) >> 5) : 64)
+
+#define HBUFF_LEN (16) /* Space for reading SOF0, SOS and DRI marker data */
+#define SPILL_LEN (10) /* Bytes one step can write past the end of a packet */
+
+/* Maximum number of symbols in the DC and AC huffman tables */
+#define DHT_DC_LEN (16)
+#define DHT_AC_LEN (162)
+
+/* Number of bits resolved in one step by the huffman decoder lookup table */
+#ifdef __AVR__
+#define DHT_LUT_BITS (4)
+#else
+#define DHT_LUT_BITS (9)
+#endif
+
+typedef struct
+{
+	uint8_t lut[1 << DHT_LUT_BITS][2]; /* Symbol and width, 0 = longer code */
+	uint16_t code;  /* First code longer than DHT_LUT_BITS              */
+	uint8_t index;  /* Symbol index of the above code                   */
+	uint8_t count[16]; /* Number of codes of each width, 1 - 16 bits    */
+} ssdv_dht_t;
+
+/* Statistics gathered by a pre-scan of the image, used to pick
+ * the quality that fits into a number of packets */
+typedef struct
+{
+	uint32_t bits[SSDV_QUALITY_LEVELS]; /* Estimated size at each quality */
+	int adc[SSDV_QUALITY_LEVELS][3];    /* DC value at each quality       */
+	uint8_t run[SSDV_QUALITY_LEVELS];   /* Zero AC parts not yet coded    */
+	uint16_t packets;                   /* Packets at the scan quality    */
+#ifndef __AVR__
+	/* The DQT values and their reciprocals at each quality, made at
+	 * the start of the scan. The AVR works them out as it goes */
+	uint8_t  dqt[SSDV_QUALITY_LEVELS][2][64];
+	uint32_t rcp[SSDV_QUALITY_LEVELS][2][64];
+#endif
+} ssdv_stats_t;
+
+#ifndef __AVR__
+/* Restart intervals can be encoded separately on a host and stitched
+ * together into packets afterwards. This records where each MCU ended up
+ * and the DC values needed to join it to whatever comes before it */
 typedef struct
 {
+	const uint8_t *data; /* The encoded interval this MCU is part of      */
+	uint32_t bit;        /* Position of the MCU in data, in bits          */
+	uint32_t len;        /* Length of the MCU in bits                     */
+	uint8_t  tail;       /* Bits written by the last step of the MCU      */
+	uint16_t dc_bit[3];  /* Position of the Y, Cb and Cr DC codes         */
+	uint8_t  dc_len[3];  /* and their length                              */
+	int      adc[3];     /* The adjusted Y, Cb and Cr DC values           */
+	int      adc_y;      /* Adjusted DC value of the last Y block         */
+} ssdv_mcu_t;
+
+/* Huffman tables made for one image, from the symbols counted by a first
+ * pass over it */
+typedef struct
+{
+	uint32_t freq[2][2][256];     /* Symbol counts, by DC/AC and Y/C        */
+	uint8_t  dhc[2][2][256 * 3];  /* The codes, laid out as std_dhc00-11    */
+	uint8_t  data[SSDV_HUFF_LEN]; /* The code lengths as they are sent      */
+} ssdv_huff_t;
+#endif
+
+typedef struct
+{
+	/* Encoding or decoding */
+	enum {
+		S_ENCODING = 0,
+		S_DECODING
+	} mode;
+	
 	/* Image information */
 	uint16_t width;
 	uint16_t height;
 	uint32_t callsign;
 	uint8_t  image_id;
 	uint16_t packet_id;
+	uint16_t pkt_size;  /* Length of each packet in bytes               */
+	uint8_t  quality;   /* 0 - 7, scales the output DQT tables          */
+	uint8_t  type;      /* Packet type flags                            */
+	uint8_t  fec;       /* FEC flags for the packets that follow        */
+	const rs8_code_t *code; /* RS code of the current packet, or NULL   */
 	uint8_t  mcu_mode;  /* 0 = 2x2, 1 = 2x1, 2 = 1x2, 3 = 1x1           */
+	uint8_t  passthrough; /* Source AC tables match, codes are copied   */
 	uint16_t mcu_id;
 	uint16_t mcu_count;
+	uint16_t out_mcu_id; /* The same in the cropped or scaled output  */
+	uint8_t  crop_x;    /* The window of the image that's encoded, in   */
+	uint8_t  crop_y;    /* 16 pixel units. A width of 0 until SOF0 is   */
+	uint8_t  crop_w;    /* the whole image                              */
+	uint8_t  crop_h;
+	uint8_t  skip;      /* The current MCU is outside the window        */
 	uint16_t packet_mcu_id;
 	uint8_t  packet_mcu_offset;
 	
@@ -68,8 +204,16 @@ typedef struct
 	size_t out_len;    /* Number of output bytes remaining              */
 	
 	/* Output bits */
+#ifdef __AVR__
 	uint32_t outbits;  /* Output bit buffer                             */
+#else
+	uint64_t outbits;
+#endif
 	uint8_t outlen;    /* Number of bits in the output bit buffer       */
+	uint8_t outspill[SPILL_LEN]; /* Bytes for the next packet           */
+	uint8_t outspill_len;
+	uint32_t fec_crc;  /* CRC of the packet bytes written so far        */
+	uint8_t fec_len;   /* Bytes in the CRC and RS codes, 0 = not begun  */
 	
 	/* JPEG decoder state */
 	enum {
@@ -78,12 +222,17 @@ typedef struct
 		S_MARKER_DATA,
 		S_HUFF,
 		S_INT,
+		S_OUT,
 		S_EOI
 	} state;
 	uint16_t marker;    /* Current marker                               */
 	uint16_t marker_len; /* Length of data following marker             */
-	uint8_t *marker_data; /* Where to copy marker data too              */
+	uint8_t marker_data[HBUFF_LEN]; /* Marker data, except tables       */
 	uint16_t marker_data_len; /* How much is there                      */
+	uint8_t tbl_id;     /* Class and ID of the table being read         */
+	uint16_t tbl_pos;   /* Bytes of the table read so far               */
+	uint16_t tbl_len;   /* Length of the table, once known              */
+	uint8_t tbls;       /* Which tables have been read, DQT 0-1 DHT 2-5 */
 	uint8_t component;  /* 0 = Y, 1 = Cb, 2 = Cr                        */
 	uint8_t ycparts;    /* Number of Y component parts per MCU          */
 	uint8_t mcupart;    /* 0-3 = Y, 4 = Cb, 5 = Cr                      */
@@ -96,23 +245,211 @@ typedef struct
 	uint32_t reset_mcu; /* MCU block to do absolute encoding            */
 	char needbits;      /* Number of bits needed to decode integer      */
 	
+	/* Downscaling, the encoder collects the low frequency corner of each
+	 * part and merges them into the output blocks */
+	uint8_t scale;      /* 0 = full size, 1 = half, 2 = quarter          */
+	int16_t *sbuf;      /* Output blocks being put together              */
+	size_t sbuf_len;    /* Length of the above, in values                */
+	int16_t *stile;     /* Where the current part goes, NULL if cropped  */
+	uint8_t stile_n;    /* Width of the corner kept from each part       */
+	int16_t *sblock;    /* The output block being written                */
+	uint8_t sblocks;    /* Output blocks left to write                   */
+	
 	/* The input huffman and quantisation tables */
-	uint8_t stbls[TBL_LEN + HBUFF_LEN];
-	uint8_t *sdht[2][2], *sdqt[2];
-	uint16_t stbl_len;
+	uint8_t sdqt[2][64];       /* In zig-zag order                      */
+	ssdv_dht_t sdhl[2][2];
+	uint8_t sdcs[2][DHT_DC_LEN]; /* DC and AC symbols, in code order     */
+	uint8_t sacs[2][DHT_AC_LEN];
+	
+	/* The output tables, in PROGMEM */
+	const uint8_t *ddqt[2];
+	const uint8_t *ddhc[2][2]; /* Huffman codes by symbol               */
 	
-	/* The same for output */
-	uint8_t dtbls[TBL_LEN];
-	uint8_t *ddht[2][2], *ddqt[2];
-	uint16_t dtbl_len;
+	/* Pre-scan statistics, NULL when encoding packets */
+	ssdv_stats_t *stats;
+	
+#ifndef __AVR__
+	/* Restart interval encoding */
+	ssdv_mcu_t *mcus;   /* MCU records, NULL when encoding packets      */
+	uint32_t stepbit;   /* Output position at the start of this step    */
+	
+	/* Per-image huffman tables. The encoder counts symbols into these
+	 * until SSDV_TYPE_HUFF is set, the decoder keeps the data as it
+	 * arrives */
+	ssdv_huff_t *huff;
+	uint16_t huff_repeat; /* Packets between copies of the tables, or 0 */
+	uint16_t huff_count;  /* Packets since the last copy                */
+	uint8_t  huff_pos;    /* Next byte of the tables to send            */
+	uint8_t  huff_data[SSDV_HUFF_LEN];
+	uint8_t  huff_have[(SSDV_HUFF_LEN + 7) / 8]; /* Bytes received      */
+	uint8_t  huff_ready;  /* All received and loaded                    */
+	
+	/* The output DQT values scaled for the quality, in zig-zag order,
+	 * and their reciprocals for re-quantising. Made at the start of the
+	 * scan, the AVR has no SRAM to spare and works them out as it goes */
+	uint8_t  dqt[2][64];
+	uint32_t dqt_rcp[2][64];
+	
+	/* The DC value of each block from the DC pass of a progressive
+	 * image, dequantised. The decoder puts them into the AC pass */
+	int16_t *dcs;
+	size_t   dcs_len;
+#endif
+	
+	/* Erasure parity of the current group of packets */
+	uint8_t *par;       /* par_m rows of SSDV_PARITY_ROW() bytes         */
+	uint8_t  par_n;     /* Packets in each group, 0 for no parity        */
+	uint8_t  par_m;     /* Parity packets sent after each group          */
+	uint8_t  par_count; /* Packets in the current group so far           */
+	uint8_t  par_next;  /* Next parity packet to send, par_m for none    */
 	
 } ssdv_t;
 
+/* A ring of packet slots. The encoder fills them ahead of time and an
+ * interrupt handler sends them, so the next packet is ready the moment
+ * the last one has gone. Only the encoder moves the head and only the
+ * sender moves the tail */
+typedef struct ssdv_ring
+{
+	uint8_t *buf;       /* 'slots' slots of pkt_size bytes each         */
+	uint8_t  slots;
+	uint16_t pkt_size;
+	volatile uint8_t head; /* Next slot to fill                       */
+	volatile uint8_t tail; /* Next slot to send                       */
+} ssdv_ring_t;
+
+typedef struct
+{
+	char     callsign_s[7];
+	uint32_t callsign;
+	uint8_t  image_id;
+	uint16_t packet_id;
+	uint16_t pkt_size;
+	uint8_t  quality;
+	uint8_t  type;
+	uint8_t  parity;    /* An erasure parity packet, not image data */
+	uint16_t width;
+	uint16_t height;
+	uint8_t  mcu_mode;
+	uint8_t  mcu_offset;
+	uint16_t mcu_id;
+	uint16_t mcu_count;
+} ssdv_packet_info_t;
+
+#ifndef __AVR__
+/* A run of packets, from one with a new MCU in it up to the next such
+ * packet or the first one missing. Each is decoded on its own */
+typedef struct
+{
+	uint8_t *buf;       /* The decoded MCUs, as a plain bit stream       */
+	size_t   buf_len;
+	uint16_t mcu_end;   /* MCUs decoded, up to but not including this    */
+	uint16_t mcu_limit; /* The first new MCU of the next run             */
+	uint8_t  dirty;     /* Packets have arrived since it was decoded     */
+} ssdv_run_t;
+
+/* An image decoded as its packets arrive, in any order */
+typedef struct
+{
+	ssdv_t      s;      /* The decoder, set up by the first packet       */
+	uint8_t    *pkts;   /* Packets by ID, SSDV_PKT_SIZE bytes each       */
+	uint8_t    *have;   /* Which of them have arrived                    */
+	ssdv_run_t *runs;   /* By packet ID, for those that begin a run      */
+	uint16_t   *todo;   /* The runs to decode, see ssdv_dec_image_runs() */
+	uint32_t    count;  /* Packet IDs there is room for                  */
+	ssdv_mcu_t *mcus;   /* Where each MCU is in the runs                 */
+} ssdv_image_t;
+#endif
+
 /* Encoding */
-extern char ssdv_enc_init(ssdv_t *s, char *callsign, uint8_t image_id);
+extern char ssdv_enc_init(ssdv_t *s, char *callsign, uint8_t image_id, uint16_t pkt_size, uint8_t quality);
+extern char ssdv_enc_set_type(ssdv_t *s, uint8_t type);
+extern char ssdv_enc_set_scale(ssdv_t *s, uint8_t scale, int16_t *buffer, size_t length);
+extern char ssdv_enc_set_crop(ssdv_t *s, uint8_t x, uint8_t y, uint8_t width, uint8_t height);
+/* fec is the number of RS codes in each packet, 0, 8, 16 or 32. Any
+ * other value means 32, so that 1 still turns them on */
+extern char ssdv_enc_set_fec(ssdv_t *s, uint8_t fec);
+extern char ssdv_enc_set_parity(ssdv_t *s, uint8_t n, uint8_t m, uint8_t *buffer, size_t length);
 extern char ssdv_enc_set_buffer(ssdv_t *s, uint8_t *buffer);
 extern char ssdv_enc_get_packet(ssdv_t *s);
 extern char ssdv_enc_feed(ssdv_t *s, uint8_t *buffer, size_t length);
+extern void ssdv_enc_fec(uint8_t *packet);
+
+/* Rate control. After ssdv_enc_prescan() the image is encoded as normal,
+ * but the packets are only counted. ssdv_enc_quality() then gives the
+ * best quality expected to fit the image into a number of packets */
+extern char ssdv_enc_prescan(ssdv_t *s, ssdv_stats_t *stats);
+extern uint8_t ssdv_enc_quality(ssdv_t *s, uint16_t packets);
+
+#ifndef __AVR__
+/* Encoding restart intervals in parallel. The stitched packets are
+ * returned without their CRC and RS codes, see ssdv_enc_fec() */
+extern char ssdv_enc_segment(ssdv_t *s, uint16_t mcu_id, uint8_t *data, size_t length, uint8_t *buffer, size_t buffer_len, ssdv_mcu_t *mcus);
+extern char ssdv_enc_stitch(ssdv_t *s, ssdv_mcu_t *mcus, uint8_t *packets, size_t *count);
+
+/* Per-image huffman tables. After ssdv_enc_huffscan() the image is encoded
+ * as normal, but only the codes are counted. ssdv_enc_set_huff() then gives
+ * a new encoder tables made from the counts. They are sent before the
+ * image, and again every 'repeat' packets unless that's 0 */
+extern char ssdv_enc_huffscan(ssdv_t *s, ssdv_huff_t *huff);
+extern char ssdv_enc_set_huff(ssdv_t *s, ssdv_huff_t *huff, uint16_t repeat);
+#endif
+
+/* Decoding */
+extern char ssdv_dec_init(ssdv_t *s);
+extern char ssdv_dec_set_buffer(ssdv_t *s, uint8_t *buffer, size_t length);
+#ifndef __AVR__
+/* A progressive image is sent in two passes with the same image ID, the
+ * DC values and then the AC values, and the packet IDs of the second carry
+ * on from the first. Given room for the DC values, SSDV_DC_LEN() of them
+ * for an image size, the decoder merges the passes. Without it, the AC
+ * pass is ignored. A full image can follow a DC pass in the same way */
+#define SSDV_DC_LEN(w, h) (((w) >> 3) * ((h) >> 3) * 3)
+extern char ssdv_dec_set_dc(ssdv_t *s, int16_t *buffer, size_t length);
+#endif
+extern char ssdv_dec_feed(ssdv_t *s, uint8_t *packet);
+extern char ssdv_dec_get_jpeg(ssdv_t *s, uint8_t **jpeg, size_t *length);
+
+/* Off the AVR, a packet that fails its CRC is corrected in place with
+ * its RS codes where it can be */
+extern char ssdv_dec_is_packet(uint8_t *packet);
+extern void ssdv_dec_header(ssdv_packet_info_t *info, uint8_t *packet);
+
+/* Packet rings. ssdv_ring_next() gives the slot to fill next, or NULL
+ * while the ring is full, and ssdv_ring_push() queues it once filled.
+ * ssdv_ring_peek() gives the next packet to send, or NULL if there are
+ * none, and ssdv_ring_pop() frees its slot once sent */
+extern char ssdv_ring_init(ssdv_ring_t *r, uint8_t *buffer, uint8_t slots, uint16_t pkt_size);
+extern uint8_t *ssdv_ring_next(ssdv_ring_t *r);
+extern void ssdv_ring_push(ssdv_ring_t *r);
+extern uint8_t *ssdv_ring_peek(ssdv_ring_t *r);
+extern void ssdv_ring_pop(ssdv_ring_t *r);
+
+#ifndef __AVR__
+/* Rebuilding lost packets from the parity packets. 'packets' holds the
+ * packets of one image in slots of pkt_size bytes by packet ID, and 'have'
+ * marks those received. 'parity' holds the parity packets received, in
+ * any order. The lost packets that can be rebuilt are filled in and
+ * marked, and the number rebuilt is returned */
+extern int ssdv_dec_recover(uint8_t *packets, uint16_t pkt_size, uint8_t *have, uint16_t count, uint8_t *parity, uint16_t parity_count);
+
+/* Out of order decoding. Packets can be fed in any order, and only the
+ * runs of packets they add to are decoded again when the JPEG is next
+ * made. ssdv_dec_image_jpeg() does that itself, or a caller with threads
+ * can first take the list from ssdv_dec_image_runs() and decode them
+ * with ssdv_dec_image_run(), any number at once, until the list is empty.
+ * The JPEG is the same as ssdv_dec_feed() gives with the packets in order
+ * and room for the DC values, except that packets which came before
+ * per-image tables were complete, or DC pass packets after the second
+ * pass began, are not lost. 'length' is the size of the buffer going in,
+ * and of the JPEG coming out */
+extern char ssdv_dec_image_init(ssdv_image_t *img);
+extern char ssdv_dec_image_feed(ssdv_image_t *img, uint8_t *packet);
+extern uint32_t ssdv_dec_image_runs(ssdv_image_t *img, uint16_t **ids);
+extern char ssdv_dec_image_run(ssdv_image_t *img, uint16_t id);
+extern char ssdv_dec_image_jpeg(ssdv_image_t *img, uint8_t *buffer, size_t *length);
+extern void ssdv_dec_image_free(ssdv_image_t *img);
+#endif
 
 #endif
 
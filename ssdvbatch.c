@@ -0,0 +1,678 @@
+
+/* ssdvbatch - Encode stored JPEG images into SSDV packets               */
+/*=======================================================================*/
+/* Copyright 2026 agent <agent@local>                                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* This is a host tool, not part of the flight firmware. Each image is
+ * encoded on a worker thread with its own ssdv_t, and the packets are
+ * written out in the order the images were given.
+ * 
+ * With -r the images are encoded one at a time instead, with the threads
+ * sharing out the restart intervals of each image. The intervals are then
+ * stitched together into packets. Images without restart markers are
+ * encoded on a single thread.
+ * 
+ * With -p each image is sent in two passes, the DC values first and then
+ * the AC values. The decoder puts them back together.
+ * 
+ * With -s the images are scaled down to half or quarter size as they
+ * are encoded, and with -x cropped to a window. These are not split at
+ * their restart markers.
+ * 
+ * With -u each pass is encoded twice, first counting the codes and then
+ * with huffman tables made to suit. Nor are these split.
+ * 
+ * With -e every n packets are followed by m erasure parity packets,
+ * which let the receiver rebuild up to m lost packets of the group.
+ * ssdvsim shows what difference they make. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "ssdv.h"
+
+typedef struct
+{
+	const char *filename;
+	uint8_t image_id;
+	size_t length;  /* Size of the JPEG file */
+	uint8_t quality;
+	int16_t *sbuf;  /* Work space for scaling the image down */
+	ssdv_huff_t *huff; /* The image's own huffman tables */
+	uint8_t *par;   /* Parity of the group being sent */
+	
+	/* The encoded packets */
+	uint8_t *pkts;
+	size_t pkt_count;
+	char r;
+	char done;
+	
+} image_t;
+
+typedef struct
+{
+	ssdv_t *ssdv;   /* The image headers, copied by each thread */
+	ssdv_mcu_t *mcus;
+	
+	/* The restart intervals */
+	uint8_t *data;
+	size_t *start;  /* Offset of each interval, and 2 past the end of the last */
+	uint8_t **bufs;
+	size_t count;
+	size_t next;
+	char r;
+	
+	/* The stitched packets */
+	uint8_t *pkts;
+	size_t pkt_count;
+	
+} split_t;
+
+static image_t *images;
+static int image_count;
+static char *callsign = "SWIFT";
+static int nthreads = 0;
+static int split = 0;
+static int pkt_size = SSDV_PKT_SIZE;
+static int quality = SSDV_QUALITY_DEFAULT;
+static int target = 0;
+static int progressive = 0;
+static uint8_t type = 0;
+static int fec = SSDV_PKT_SIZE_RSCODES; /* RS codes per packet */
+static int scale = SSDV_SCALE_FULL;
+static int crop[4] = { 0, 0, 0, 0 }; /* x, y, width, height, in 16 pixel units */
+static int huff = -1; /* Packets between copies of the huffman tables, -1 for none */
+static int parity[2] = { 0, 0 }; /* Groups of n packets, followed by m parity packets */
+
+/* Scaling work space for the largest image */
+#define SBUF_LEN (SSDV_SCALE_LEN(4080, scale))
+
+/* The next image to encode, and the next to be written */
+static int next_image = 0;
+static int next_write = 0;
+static int window;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+static void *split_worker(void *arg)
+{
+	split_t *sp = arg;
+	ssdv_t ssdv;
+	size_t len, i;
+	char r;
+	
+	while(1)
+	{
+		pthread_mutex_lock(&lock);
+		i = sp->next++;
+		pthread_mutex_unlock(&lock);
+		
+		if(i >= sp->count) break;
+		
+		/* Start with twice the size of the source data, growing if needed */
+		len = (sp->start[i + 1] - 2 - sp->start[i]) * 2 + 64;
+		
+		do
+		{
+			free(sp->bufs[i]);
+			if(!(sp->bufs[i] = malloc(len))) { r = SSDV_ERROR; break; }
+			
+			ssdv = *sp->ssdv;
+			r = ssdv_enc_segment(&ssdv, i * ssdv.dri,
+				&sp->data[sp->start[i]], sp->start[i + 1] - 2 - sp->start[i],
+				sp->bufs[i], len, sp->mcus);
+			
+			len *= 2;
+		}
+		while(r == SSDV_BUFFER_FULL);
+		
+		if(r != SSDV_OK)
+		{
+			pthread_mutex_lock(&lock);
+			sp->r = SSDV_ERROR;
+			pthread_mutex_unlock(&lock);
+		}
+	}
+	
+	return(NULL);
+}
+
+static void *fec_worker(void *arg)
+{
+	split_t *sp = arg;
+	size_t i, n;
+	
+	while(1)
+	{
+		/* Take a few packets at a time */
+		pthread_mutex_lock(&lock);
+		i = sp->next;
+		sp->next += 16;
+		pthread_mutex_unlock(&lock);
+		
+		if(i >= sp->pkt_count) break;
+		
+		n = (sp->pkt_count - i < 16 ? sp->pkt_count - i : 16);
+		for(; n > 0; n--, i++) ssdv_enc_fec(&sp->pkts[i * pkt_size]);
+	}
+	
+	return(NULL);
+}
+
+static char encode_image_split(image_t *img, uint8_t *data, size_t length)
+{
+	ssdv_t ssdv;
+	split_t sp;
+	pthread_t *threads;
+	uint8_t pkt[SSDV_PKT_SIZE];
+	size_t i, n, max, base = img->pkt_count;
+	uint8_t m;
+	int t;
+	char r;
+	
+	/* Find the end of the SOS header */
+	for(i = 2, m = 0; m != 0xDA && i + 4 <= length && data[i] == 0xFF; i += n)
+	{
+		m = data[i + 1];
+		n = 2 + ((data[i + 2] << 8) | data[i + 3]);
+	}
+	if(m != 0xDA || i >= length) return(SSDV_FEED_ME);
+	
+	/* Read the headers */
+	ssdv_enc_init(&ssdv, callsign, img->image_id, pkt_size, img->quality);
+	ssdv_enc_set_type(&ssdv, type | (progressive ? SSDV_TYPE_AC : 0));
+	ssdv_enc_set_fec(&ssdv, fec);
+	ssdv_enc_set_buffer(&ssdv, pkt);
+	ssdv_enc_feed(&ssdv, data, i);
+	if(ssdv_enc_get_packet(&ssdv) != SSDV_FEED_ME || ssdv.state != S_HUFF ||
+	   ssdv.dri == 0) return(SSDV_FEED_ME);
+	
+	/* Find the restart intervals */
+	memset(&sp, 0, sizeof(sp));
+	sp.ssdv  = &ssdv;
+	sp.data  = data;
+	sp.count = (ssdv.mcu_count + ssdv.dri - 1) / ssdv.dri;
+	sp.start = malloc((sp.count + 1) * sizeof(size_t));
+	sp.bufs  = calloc(sp.count, sizeof(uint8_t *));
+	sp.mcus  = malloc(ssdv.mcu_count * sizeof(ssdv_mcu_t));
+	threads  = malloc(nthreads * sizeof(pthread_t));
+	r = (sp.start && sp.bufs && sp.mcus && threads ? SSDV_OK : SSDV_ERROR);
+	
+	/* Each interval begins after a marker, the first being the SOS */
+	if(r == SSDV_OK) sp.start[0] = i;
+	for(n = 1; r == SSDV_OK && i + 1 < length; i++)
+	{
+		if(data[i] != 0xFF) continue;
+		if(data[i + 1] == 0xD9) break;
+		if(data[i + 1] >= 0xD0 && data[i + 1] <= 0xD7)
+		{
+			if(n < sp.count) sp.start[n] = i + 2;
+			n++;
+		}
+		
+		/* Step over the stuffing byte or marker */
+		i++;
+	}
+	
+	/* Fall back to one thread if the markers don't match up */
+	if(r == SSDV_OK && (n != sp.count || i + 1 >= length)) r = SSDV_FEED_ME;
+	
+	if(r == SSDV_OK)
+	{
+		/* The last interval ends at the EOI marker */
+		sp.start[n] = i + 2;
+		for(t = 0; t < nthreads; t++)
+			pthread_create(&threads[t], NULL, split_worker, &sp);
+		for(t = 0; t < nthreads; t++)
+			pthread_join(threads[t], NULL);
+		r = sp.r;
+	}
+	
+	/* Stitch the intervals into packets, guessing at about the
+	 * size of the source image and trying again if that's short */
+	for(max = length / SSDV_PKT_PAYLOAD(pkt_size, ssdv.type) + 16; r == SSDV_OK; max *= 2)
+	{
+		ssdv_t st = ssdv;
+		uint8_t *p;
+		
+		/* The packets follow any from an earlier pass */
+		if(!(p = realloc(img->pkts, (base + max) * pkt_size))) { r = SSDV_ERROR; break; }
+		img->pkts = p;
+		
+		st.packet_id = base;
+		n = max;
+		r = ssdv_enc_stitch(&st, sp.mcus, &img->pkts[base * pkt_size], &n);
+		if(r != SSDV_BUFFER_FULL) break;
+		r = SSDV_OK;
+	}
+	
+	/* Generate the CRC and RS codes */
+	if(r == SSDV_OK)
+	{
+		img->pkt_count = base + n;
+		sp.pkts = &img->pkts[base * pkt_size];
+		sp.pkt_count = n;
+		sp.next = 0;
+		
+		for(t = 0; t < nthreads; t++)
+			pthread_create(&threads[t], NULL, fec_worker, &sp);
+		for(t = 0; t < nthreads; t++)
+			pthread_join(threads[t], NULL);
+	}
+	
+	if(sp.bufs) for(i = 0; i < sp.count; i++) free(sp.bufs[i]);
+	free(sp.bufs);
+	free(sp.start);
+	free(sp.mcus);
+	free(threads);
+	
+	return(r);
+}
+
+static void encoder_init(ssdv_t *ssdv, image_t *img, uint8_t q, uint8_t type)
+{
+	ssdv_enc_init(ssdv, callsign, img->image_id, pkt_size, q);
+	ssdv_enc_set_type(ssdv, type);
+	ssdv_enc_set_fec(ssdv, fec);
+	ssdv_enc_set_scale(ssdv, scale, img->sbuf, SBUF_LEN);
+	if(crop[2]) ssdv_enc_set_crop(ssdv, crop[0], crop[1], crop[2], crop[3]);
+	if(parity[1]) ssdv_enc_set_parity(ssdv, parity[0], parity[1], img->par, SSDV_PARITY_LEN(pkt_size, parity[1]));
+}
+
+static uint8_t pick_quality(image_t *img, uint8_t *data, size_t length)
+{
+	ssdv_t ssdv;
+	ssdv_stats_t stats;
+	uint8_t pkt[SSDV_PKT_SIZE];
+	
+	/* Count the packets at the given quality, estimating the others */
+	encoder_init(&ssdv, img, quality, type);
+	ssdv_enc_set_buffer(&ssdv, pkt);
+	ssdv_enc_prescan(&ssdv, &stats);
+	ssdv_enc_feed(&ssdv, data, length);
+	while(ssdv_enc_get_packet(&ssdv) == SSDV_OK);
+	
+	return(ssdv_enc_quality(&ssdv, target));
+}
+
+static char scan_huff(image_t *img, uint8_t *data, size_t length, uint8_t q, uint8_t type)
+{
+	ssdv_t ssdv;
+	uint8_t pkt[SSDV_PKT_SIZE];
+	char r;
+	
+	/* Count the codes this pass would use */
+	encoder_init(&ssdv, img, q, type);
+	ssdv_enc_set_buffer(&ssdv, pkt);
+	ssdv_enc_huffscan(&ssdv, img->huff);
+	ssdv_enc_feed(&ssdv, data, length);
+	while((r = ssdv_enc_get_packet(&ssdv)) == SSDV_OK);
+	
+	return(r == SSDV_EOI ? SSDV_OK : SSDV_ERROR);
+}
+
+static char encode_serial(image_t *img, uint8_t *data, size_t length, uint8_t q, uint8_t type)
+{
+	ssdv_t ssdv;
+	size_t pkts_len = img->pkt_count;
+	char r;
+	
+	if(img->huff && scan_huff(img, data, length, q, type) != SSDV_OK) return(SSDV_ERROR);
+	
+	encoder_init(&ssdv, img, q, type);
+	if(img->huff) ssdv_enc_set_huff(&ssdv, img->huff, huff);
+	ssdv_enc_feed(&ssdv, data, length);
+	
+	/* The packets follow any from an earlier pass */
+	ssdv.packet_id = img->pkt_count;
+	
+	while(1)
+	{
+		/* Grow the packet buffer when needed */
+		if(img->pkt_count == pkts_len)
+		{
+			uint8_t *p;
+			
+			pkts_len = (pkts_len ? pkts_len * 2 : 64);
+			p = realloc(img->pkts, pkts_len * pkt_size);
+			if(!p) { r = SSDV_ERROR; break; }
+			img->pkts = p;
+		}
+		
+		ssdv_enc_set_buffer(&ssdv, &img->pkts[img->pkt_count * pkt_size]);
+		
+		r = ssdv_enc_get_packet(&ssdv);
+		if(r != SSDV_OK) break;
+		
+		img->pkt_count++;
+	}
+	
+	/* The whole file was fed in, so needing more data is an error */
+	return(r == SSDV_EOI ? SSDV_OK : SSDV_ERROR);
+}
+
+static char encode_image(image_t *img)
+{
+	uint8_t *data;
+	struct stat st;
+	int fd;
+	char r = SSDV_OK;
+	
+	if((fd = open(img->filename, O_RDONLY)) < 0) return(SSDV_ERROR);
+	if(fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return(SSDV_ERROR);
+	}
+	
+	img->length = st.st_size;
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED) return(SSDV_ERROR);
+	
+	if((scale && !(img->sbuf = malloc(SBUF_LEN * sizeof(int16_t)))) ||
+	   (huff >= 0 && !(img->huff = malloc(sizeof(ssdv_huff_t)))) ||
+	   (parity[1] && !(img->par = malloc(SSDV_PARITY_LEN(pkt_size, parity[1])))))
+	{
+		munmap(data, st.st_size);
+		free(img->sbuf);
+		free(img->huff);
+		img->sbuf = NULL;
+		img->huff = NULL;
+		return(SSDV_ERROR);
+	}
+	
+	img->quality = (target ? pick_quality(img, data, st.st_size) : quality);
+	
+	/* Both passes are at the same quality, so that together
+	 * they make the same image as a single pass */
+	if(progressive) r = encode_serial(img, data, st.st_size, img->quality, type | SSDV_TYPE_DC);
+	
+	if(r == SSDV_OK)
+	{
+		/* Images without restart intervals are encoded the normal way */
+		r = (split && !scale && !crop[2] && huff < 0 && !parity[1] ? encode_image_split(img, data, st.st_size) : SSDV_FEED_ME);
+		if(r == SSDV_FEED_ME) r = encode_serial(img, data, st.st_size, img->quality, type | (progressive ? SSDV_TYPE_AC : 0));
+	}
+	
+	munmap(data, st.st_size);
+	free(img->sbuf);
+	free(img->huff);
+	free(img->par);
+	img->sbuf = NULL;
+	img->huff = NULL;
+	img->par = NULL;
+	
+	return(r);
+}
+
+static void *worker(void *arg)
+{
+	image_t *img;
+	
+	/* The images are shared, there's nothing to pass in */
+	(void) arg;
+	
+	while(1)
+	{
+		/* Take the next image, but don't get too far ahead of the writer */
+		pthread_mutex_lock(&lock);
+		while(next_image < image_count && next_image >= next_write + window)
+			pthread_cond_wait(&cond, &lock);
+		
+		if(next_image >= image_count)
+		{
+			pthread_mutex_unlock(&lock);
+			break;
+		}
+		
+		img = &images[next_image++];
+		pthread_mutex_unlock(&lock);
+		
+		img->r = encode_image(img);
+		
+		pthread_mutex_lock(&lock);
+		img->done = 1;
+		pthread_cond_broadcast(&cond);
+		pthread_mutex_unlock(&lock);
+	}
+	
+	return(NULL);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"Usage: ssdvbatch [options] -o <output> <input.jpg> [...]\n"
+		"\n"
+		"  -c Callsign (default SWIFT)\n"
+		"  -i First image ID (default 0)\n"
+		"  -t Number of worker threads (default all cores)\n"
+		"  -r Split each image at its restart markers across the threads\n"
+		"  -l Packet length, 64 to 256 bytes in steps of 32 (default 256)\n"
+		"  -q Quality, 0 to 7 (default 4)\n"
+		"  -n Pick the quality of each image to fit this many packets\n"
+		"  -p Send each image in two passes, the DC values and then the AC values\n"
+		"  -g Grayscale, leave out the chroma\n"
+		"  -f Leave out the RS codes, for strong links or stored copies\n"
+		"  -R Number of RS codes in each packet, 8, 16 or 32 (default 32)\n"
+		"  -s Scale the images down, 1 = half size, 2 = quarter size\n"
+		"  -x Crop the images to x,y,width,height in 16 pixel units\n"
+		"  -u Make huffman tables for each image, sent again every n packets (0 = once)\n"
+		"  -e Follow every n packets with m erasure parity packets, given as n,m\n"
+		"  -o Output file for the packets, - for stdout\n");
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t *threads;
+	int i, c, workers, first_id = 0;
+	char *output = NULL;
+	size_t packets = 0, length = 0;
+	double t;
+	FILE *fout;
+	
+	while((c = getopt(argc, argv, "c:i:t:rl:q:n:pgfR:s:x:u:e:o:")) != -1)
+	{
+		switch(c)
+		{
+		case 'c': callsign = optarg; break;
+		case 'i': first_id = atoi(optarg); break;
+		case 't': nthreads = atoi(optarg); break;
+		case 'r': split = 1; break;
+		case 'l': pkt_size = atoi(optarg); break;
+		case 'q': quality = atoi(optarg); break;
+		case 'n': target = atoi(optarg); break;
+		case 'p': progressive = 1; break;
+		case 'g': type = SSDV_TYPE_GRAY; break;
+		case 'f': fec = 0; break;
+		case 'R': fec = atoi(optarg); break;
+		case 's': scale = atoi(optarg); break;
+		case 'x':
+			if(sscanf(optarg, "%d,%d,%d,%d", &crop[0], &crop[1], &crop[2], &crop[3]) != 4)
+				crop[2] = -1;
+			break;
+		case 'u': huff = atoi(optarg); break;
+		case 'e':
+			if(sscanf(optarg, "%d,%d", &parity[0], &parity[1]) != 2)
+				parity[0] = -1;
+			break;
+		case 'o': output = optarg; break;
+		default: usage(); return(-1);
+		}
+	}
+	
+	image_count = argc - optind;
+	if(!output || image_count <= 0)
+	{
+		usage();
+		return(-1);
+	}
+	
+	if(pkt_size < SSDV_PKT_SIZE_MIN || pkt_size > SSDV_PKT_SIZE || pkt_size % 32)
+	{
+		fprintf(stderr, "Packet length must be 64 to 256 bytes, in steps of 32\n");
+		return(-1);
+	}
+	
+	if(quality < 0 || quality >= SSDV_QUALITY_LEVELS)
+	{
+		fprintf(stderr, "Quality must be 0 to 7\n");
+		return(-1);
+	}
+	
+	if(scale < SSDV_SCALE_FULL || scale > SSDV_SCALE_QUARTER)
+	{
+		fprintf(stderr, "Scale must be 0 to 2\n");
+		return(-1);
+	}
+	
+	if(huff < -1 || huff > 0xFFFF)
+	{
+		fprintf(stderr, "Huffman table interval must be 0 to 65535 packets\n");
+		return(-1);
+	}
+	
+	if(huff >= 0 && progressive)
+	{
+		fprintf(stderr, "Progressive images use the standard huffman tables\n");
+		return(-1);
+	}
+	
+	if(fec != 0 && fec != 8 && fec != 16 && fec != 32)
+	{
+		fprintf(stderr, "Number of RS codes must be 8, 16 or 32\n");
+		return(-1);
+	}
+	
+	if(parity[0] < 0 || parity[1] < 0 || (parity[1] && parity[0] == 0) ||
+	   parity[0] + parity[1] > 255)
+	{
+		fprintf(stderr, "Parity must be n,m packets, with n + m up to 255\n");
+		return(-1);
+	}
+	
+	if(crop[0] < 0 || crop[0] > 255 || crop[1] < 0 || crop[1] > 255 ||
+	   crop[2] < 0 || crop[2] > 255 || crop[3] < 0 || crop[3] > 255 ||
+	   (crop[2] == 0) != (crop[3] == 0))
+	{
+		fprintf(stderr, "Crop must be x,y,width,height, 0 to 255 each\n");
+		return(-1);
+	}
+	
+	if(nthreads <= 0) nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if(nthreads <= 0) nthreads = 1;
+	if(!split && nthreads > image_count) nthreads = image_count;
+	window = nthreads * 2;
+	
+	/* In split mode the threads are started for each image instead */
+	workers = (split ? 0 : nthreads);
+	
+	if(strcmp(output, "-") == 0) fout = stdout;
+	else if(!(fout = fopen(output, "wb")))
+	{
+		fprintf(stderr, "Error opening '%s' for output\n", output);
+		return(-1);
+	}
+	
+	images = calloc(image_count, sizeof(image_t));
+	threads = calloc(nthreads, sizeof(pthread_t));
+	if(!images || !threads) return(-1);
+	
+	for(i = 0; i < image_count; i++)
+	{
+		images[i].filename = argv[optind + i];
+		images[i].image_id = first_id + i;
+	}
+	
+	t = now();
+	
+	for(i = 0; i < workers; i++)
+		pthread_create(&threads[i], NULL, worker, NULL);
+	
+	/* Write the packets of each image in order as they complete */
+	for(i = 0; i < image_count; i++)
+	{
+		image_t *img = &images[i];
+		
+		if(split)
+		{
+			img->r = encode_image(img);
+			img->done = 1;
+		}
+		
+		pthread_mutex_lock(&lock);
+		while(!img->done) pthread_cond_wait(&cond, &lock);
+		pthread_mutex_unlock(&lock);
+		
+		if(img->r != SSDV_OK)
+			fprintf(stderr, "%s: Error encoding image, %zu packets written\n",
+				img->filename, img->pkt_count);
+		else if(target)
+			fprintf(stderr, "%s: Quality %i, %zu packets\n",
+				img->filename, img->quality, img->pkt_count);
+		
+		fwrite(img->pkts, pkt_size, img->pkt_count, fout);
+		packets += img->pkt_count;
+		length += img->length;
+		
+		free(img->pkts);
+		img->pkts = NULL;
+		
+		pthread_mutex_lock(&lock);
+		next_write = i + 1;
+		pthread_cond_broadcast(&cond);
+		pthread_mutex_unlock(&lock);
+	}
+	
+	for(i = 0; i < workers; i++)
+		pthread_join(threads[i], NULL);
+	
+	t = now() - t;
+	
+	if(fout != stdout) fclose(fout);
+	
+	fprintf(stderr, "%i images, %zu packets in %.3f seconds using %i threads\n",
+		image_count, packets, t, nthreads);
+	fprintf(stderr, "%.1f images/s, %.1f packets/s\n",
+		image_count / t, packets / t);
+	
+	/* Most of the overhead is in the fixed header, CRC and RS codes */
+	fprintf(stderr, "%zu bytes of JPEG sent in %zu bytes, %.1f%% payload per packet\n",
+		length, packets * pkt_size,
+		100.0 * SSDV_PKT_PAYLOAD(pkt_size, SSDV_TYPE_RS(fec)) / pkt_size);
+	
+	free(threads);
+	free(images);
+	
+	return(0);
+}
+
@@ -0,0 +1,783 @@
+
+/* ssdvbench - Time parts of the SSDV encoder on the host                */
+/*=======================================================================*/
+/* Copyright 2026 agent <agent@local>                                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* This is a host tool, not part of the flight firmware. It includes
+ * ssdv.c to reach the code inside it, and times that against the simpler
+ * code it replaced, which is kept here. The host is much faster than the
+ * AVR, but the ratio between the two is a fair guide. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "ssdv.c"
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/*****************************************************************************/
+
+/* huff - Reading the huffman codes of the source JPEG. jpeg_dht_lookup()
+ * against the search of each code in turn that came before it */
+
+/* The search, taking the DHT marker data */
+static char huff_search(const uint8_t *dht, uint32_t workbits, uint8_t worklen, uint8_t *symbol, uint8_t *width)
+{
+	const uint8_t *ss = &dht[17];
+	uint16_t code = 0;
+	uint8_t cw, n;
+	
+	for(cw = 1; cw <= 16; cw++)
+	{
+		if(cw > worklen) return(SSDV_FEED_ME);
+		
+		for(n = dht[cw]; n > 0; n--, ss++, code++)
+		{
+			if(workbits >> (worklen - cw) == code)
+			{
+				*symbol = *ss;
+				*width = cw;
+				return(SSDV_OK);
+			}
+		}
+		
+		code <<= 1;
+	}
+	
+	return(SSDV_ERROR);
+}
+
+/* Random symbols, each as likely as the length of its code suggests,
+ * written out as a bit stream. The symbols are also kept in order */
+static uint8_t *huff_stream(const uint8_t *dht, uint8_t *symbols, uint32_t n)
+{
+	uint16_t codes[256];
+	uint8_t widths[256];
+	uint8_t *data, *p;
+	uint32_t i, bits = 0;
+	uint16_t code = 0, r;
+	uint8_t cw, k, len = 0, ns = 0;
+	
+	for(cw = 1; cw <= 16; cw++, code <<= 1)
+		for(k = dht[cw]; k > 0; k--, ns++, code++)
+		{
+			codes[ns] = code;
+			widths[ns] = cw;
+		}
+	
+	if(!(p = data = calloc(n * 2 + 8, 1))) return(NULL);
+	
+	for(i = 0; i < n; i++)
+	{
+		/* Random bits pick a code with the right odds. The few that
+		 * match no code are drawn again */
+		do
+		{
+			r = rand() & 0xFFFF;
+			for(k = 0; k < ns && r >> (16 - widths[k]) != codes[k]; k++);
+		}
+		while(k == ns);
+		
+		symbols[i] = dht[17 + k];
+		
+		bits = (bits << widths[k]) | codes[k];
+		for(len += widths[k]; len >= 8; len -= 8) *(p++) = bits >> (len - 8);
+	}
+	if(len) *(p++) = bits << (8 - len);
+	
+	return(data);
+}
+
+static int bench_huff(int argc, char *argv[])
+{
+	const uint8_t *dht[4] = { std_dht00, std_dht01, std_dht10, std_dht11 };
+	const char *name[4] = { "DC Y", "DC C", "AC Y", "AC C" };
+	uint32_t i, n = (argc > 1 ? atol(argv[1]) : 1 << 20);
+	uint8_t *symbols, *data, *p, symbol, width;
+	double t[2];
+	ssdv_t s;
+	int j, m, r, bad = 0;
+	
+	symbols = malloc(n);
+	if(!symbols) return(-1);
+	
+	ssdv_dec_init(&s);
+	
+	printf("Huffman decoding, %lu symbols from each table, lookup table of %i bits\n",
+		(unsigned long) n, DHT_LUT_BITS);
+	printf("Table      search      lookup\n");
+	
+	for(j = 0; j < 4; j++)
+	{
+		data = huff_stream(dht[j], symbols, n);
+		if(!data) return(-1);
+		
+		s.acpart = (j & 2 ? 1 : 0);
+		s.component = j & 1;
+		
+		for(m = 0; m < 2; m++)
+		{
+			t[m] = now();
+			
+			for(i = 0, p = data, s.workbits = s.worklen = 0; i < n; i++)
+			{
+				while(s.worklen <= 24)
+				{
+					s.workbits = (s.workbits << 8) | *(p++);
+					s.worklen += 8;
+				}
+				
+				if(m == 0) r = huff_search(dht[j], s.workbits, s.worklen, &symbol, &width);
+				else r = jpeg_dht_lookup(&s, &symbol, &width);
+				
+				if(r != SSDV_OK || symbol != symbols[i])
+				{
+					bad++;
+					break;
+				}
+				
+				s.worklen -= width;
+				s.workbits &= (1UL << s.worklen) - 1;
+			}
+			
+			t[m] = now() - t[m];
+		}
+		
+		printf("%-6s %7.1f M/s %7.1f M/s  (%.1fx)\n", name[j],
+			n / t[0] / 1e6, n / t[1] / 1e6, t[0] / t[1]);
+		
+		free(data);
+	}
+	
+	free(symbols);
+	
+	if(bad) printf("Symbols decoded wrongly in %i tests!\n", bad);
+	
+	return(bad ? 1 : 0);
+}
+
+/*****************************************************************************/
+
+/* outbits - Writing the output bit stream. ssdv_outbits(), a word at a
+ * time with bytes that don't fit kept for the next packet, against the
+ * byte at a time writer that came before it */
+
+/* The old writer, which leaves bits that don't fit in the work area */
+static char outbits_byte(ssdv_t *s, uint16_t bits, uint8_t length)
+{
+	uint8_t b;
+	
+	if(length)
+	{
+		s->outbits <<= length;
+		s->outbits |= bits & ((1 << length) - 1);
+		s->outlen += length;
+	}
+	
+	while(s->outlen >= 8 && s->out_len > 0)
+	{
+		b = s->outbits >> (s->outlen - 8);
+		
+		/* Put the byte into the output buffer */
+		*(s->outp++) = b;
+		s->outlen -= 8;
+		s->out_len--;
+	}
+	
+	return(s->out_len ? SSDV_OK : SSDV_BUFFER_FULL);
+}
+
+static int bench_outbits(int argc, char *argv[])
+{
+	uint32_t i, n = (argc > 1 ? atol(argv[1]) : 1 << 22);
+	uint16_t *codes;
+	uint8_t *lens, *out[2];
+	size_t len[2];
+	double t[2];
+	ssdv_t s;
+	int m;
+	
+	codes = malloc(n * sizeof(uint16_t));
+	lens = malloc(n);
+	out[0] = malloc(n * 2 + SSDV_PKT_SIZE);
+	out[1] = malloc(n * 2 + SSDV_PKT_SIZE);
+	if(!codes || !lens || !out[0] || !out[1]) return(-1);
+	
+	/* Codes of 1 to 16 bits, as the huffman codes and values are */
+	srand(1);
+	for(i = 0; i < n; i++)
+	{
+		lens[i] = 1 + rand() % 16;
+		codes[i] = rand() & ((1 << lens[i]) - 1);
+	}
+	
+	for(m = 0; m < 2; m++)
+	{
+		memset(&s, 0, sizeof(s));
+		s.mode = S_ENCODING;
+		s.outp = out[m];
+		s.out_len = SSDV_PKT_SIZE_PAYLOAD;
+		
+		t[m] = now();
+		
+		for(i = 0; i < n; i++)
+		{
+			if(m == 0) outbits_byte(&s, codes[i], lens[i]);
+			else ssdv_outbits(&s, codes[i], lens[i]);
+			
+			/* The packets follow on from each other in the buffer,
+			 * beginning with what didn't fit in the last one */
+			if(s.out_len == 0)
+			{
+				s.out_len = SSDV_PKT_SIZE_PAYLOAD;
+				memcpy(s.outp, s.outspill, s.outspill_len);
+				s.outp    += s.outspill_len;
+				s.out_len -= s.outspill_len;
+				s.outspill_len = 0;
+				
+				if(m == 0) outbits_byte(&s, 0, 0);
+				else ssdv_outbits_slow(&s);
+			}
+		}
+		
+		/* Pad out the last byte */
+		if(s.outlen % 8)
+		{
+			if(m == 0) outbits_byte(&s, 0xFF, 8 - s.outlen % 8);
+			else ssdv_outbits_sync(&s);
+		}
+		
+		t[m] = now() - t[m];
+		len[m] = s.outp - out[m];
+	}
+	
+	printf("Bit writer, %lu codes of 1-16 bits in %i byte packets\n",
+		(unsigned long) n, SSDV_PKT_SIZE_PAYLOAD);
+	printf("Writer            codes/s      ns/code\n");
+	printf("byte at a time  %7.1f M/s  %7.2f\n", n / t[0] / 1e6, t[0] * 1e9 / n);
+	printf("ssdv_outbits    %7.1f M/s  %7.2f  (%.1fx)\n", n / t[1] / 1e6, t[1] * 1e9 / n, t[0] / t[1]);
+	
+	m = (len[0] != len[1] || memcmp(out[0], out[1], len[0]) != 0);
+	if(m) printf("The writers gave different bit streams!\n");
+	
+	free(codes);
+	free(lens);
+	free(out[0]);
+	free(out[1]);
+	
+	return(m);
+}
+
+/*****************************************************************************/
+
+/* rs8enc - The RS codes of a 256 byte packet, 223 bytes of data and the
+ * 32 root code. rs8_encode(), and rs8_encode_byte() as the encoder uses
+ * it, against the encoder that came before them. That reduced each sum
+ * of two logs mod 255, and shifted the parity in a pass of its own */
+
+extern const uint8_t alpha_to[], index_of[];
+
+static int rs8enc_mod255(int x)
+{
+	while(x >= 255)
+	{
+		x -= 255;
+		x = (x >> 8) + (x & 255);
+	}
+	return(x);
+}
+
+static void rs8enc_old(const uint8_t *poly, uint8_t *data, uint8_t *parity)
+{
+	int i, j;
+	uint8_t feedback;
+	
+	memset(parity, 0, 32);
+	
+	for(i = 0; i < 223; i++)
+	{
+		feedback = index_of[data[i] ^ parity[0]];
+		if(feedback != 255)
+		{
+			for(j = 1; j < 32; j++)
+				parity[j] ^= alpha_to[rs8enc_mod255(feedback + poly[32 - j])];
+		}
+		
+		/* Shift */
+		memmove(&parity[0], &parity[1], 31);
+		if(feedback != 255)
+			parity[31] = alpha_to[rs8enc_mod255(feedback + poly[0])];
+		else
+			parity[31] = 0;
+	}
+}
+
+/* The time stamp counter, which counts at a fixed rate, where there is one */
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES() (__rdtsc())
+#else
+#define CYCLES() (0)
+#endif
+
+static int bench_rs8enc(int argc, char *argv[])
+{
+	const char *name[3] = { "old", "rs8_encode", "rs8_encode_byte" };
+	const rs8_code_t *code = rs8_code(32);
+	uint32_t i, n = (argc > 1 ? atol(argv[1]) : 100000);
+	uint8_t *data, *parity[3];
+	uint64_t c[3];
+	double t[3];
+	int j, m, bad = 0;
+	
+	data = malloc(n * 223);
+	for(m = 0; m < 3; m++) parity[m] = malloc(n * 32);
+	if(!code || !data || !parity[0] || !parity[1] || !parity[2]) return(-1);
+	
+	srand(1);
+	for(i = 0; i < n * 223; i++) data[i] = rand();
+	
+	for(m = 0; m < 3; m++)
+	{
+		t[m] = now();
+		c[m] = CYCLES();
+		
+		for(i = 0; i < n; i++)
+		{
+			uint8_t *d = &data[i * 223], *p = &parity[m][i * 32];
+			
+			if(m == 0) rs8enc_old(code->poly, d, p);
+			else if(m == 1) rs8_encode(code, d, p, 0);
+			else
+			{
+				memset(p, 0, 32);
+				for(j = 0; j < 223; j++) rs8_encode_byte(code, d[j], p);
+			}
+		}
+		
+		c[m] = CYCLES() - c[m];
+		t[m] = now() - t[m];
+		
+		if(m > 0 && memcmp(parity[0], parity[m], n * 32) != 0) bad++;
+	}
+	
+	printf("RS encoding, %lu packets of 223 data bytes and 32 roots\n", (unsigned long) n);
+	printf("Encoder            ns/packet  cycles/packet\n");
+	for(m = 0; m < 3; m++)
+		printf("%-16s %9.0f  %13.0f  (%.1fx)\n", name[m], t[m] * 1e9 / n,
+			(double) c[m] / n, t[0] / t[m]);
+	
+	free(data);
+	for(m = 0; m < 3; m++) free(parity[m]);
+	
+	if(bad) printf("The encoders gave different codes for %i tests!\n", bad);
+	
+	return(bad ? 1 : 0);
+}
+
+/*****************************************************************************/
+
+/* rs8dec - Checking and correcting received packets with
+ * ssdv_dec_is_packet(), on one thread and then on several, as a ground
+ * station taking packets from many receivers might. Each packet has
+ * some bytes changed after the header */
+
+typedef struct
+{
+	uint8_t *pkts;
+	uint32_t first;
+	uint32_t count;
+	uint32_t ok;
+	
+} rs8dec_work_t;
+
+static void *rs8dec_worker(void *arg)
+{
+	rs8dec_work_t *w = arg;
+	uint32_t i;
+	
+	for(i = w->first, w->ok = 0; i < w->first + w->count; i++)
+		if(ssdv_dec_is_packet(&w->pkts[i * SSDV_PKT_SIZE]) == SSDV_OK) w->ok++;
+	
+	return(NULL);
+}
+
+static int bench_rs8dec(int argc, char *argv[])
+{
+	uint32_t i, j, n = 20000, errors = 8, roots = 32, ok = 0;
+	int c, m, threads = sysconf(_SC_NPROCESSORS_ONLN), bad = 0;
+	uint8_t *pkts, *sent, *work;
+	rs8dec_work_t w[64];
+	pthread_t th[64];
+	double t[2];
+	
+	while((c = getopt(argc, argv, "t:e:r:")) != -1)
+	{
+		switch(c)
+		{
+		case 't': threads = atoi(optarg); break;
+		case 'e': errors = atol(optarg); break;
+		case 'r': roots = atol(optarg); break;
+		default: return(-1);
+		}
+	}
+	if(optind < argc) n = atol(argv[optind]);
+	if(threads < 1) threads = 1;
+	if(threads > 64) threads = 64;
+	
+	if(n == 0 || errors > SSDV_PKT_SIZE - SSDV_PKT_SIZE_HEADER ||
+	   (roots != 8 && roots != 16 && roots != 32))
+	{
+		fprintf(stderr, "Usage: ssdvbench rs8dec [-t threads] [-e errors] [-r 8|16|32] [packets]\n");
+		return(-1);
+	}
+	
+	sent = malloc(n * SSDV_PKT_SIZE);
+	pkts = malloc(n * SSDV_PKT_SIZE);
+	work = malloc(n * SSDV_PKT_SIZE);
+	if(!sent || !pkts || !work) return(-1);
+	
+	/* Full size packets with RS codes, then the same with 'errors'
+	 * bytes changed. The header is left alone, it gives the code */
+	srand(1);
+	for(i = 0; i < n; i++)
+	{
+		uint8_t *p = &sent[i * SSDV_PKT_SIZE], *q = &pkts[i * SSDV_PKT_SIZE];
+		
+		for(j = 0; j < SSDV_PKT_SIZE; j++) p[j] = rand();
+		p[0]  = 0x55;
+		p[1]  = SSDV_TYPE ^ SSDV_TYPE_RS(roots);
+		p[11] = 0;
+		ssdv_enc_fec(p);
+		
+		memcpy(q, p, SSDV_PKT_SIZE);
+		for(j = 0; j < errors;)
+		{
+			c = SSDV_PKT_SIZE_HEADER + rand() % (SSDV_PKT_SIZE - SSDV_PKT_SIZE_HEADER);
+			if(q[c] != p[c]) continue;
+			q[c] ^= 1 + rand() % 255;
+			j++;
+		}
+	}
+	
+	for(m = 0; m < 2; m++)
+	{
+		int k = (m ? threads : 1);
+		
+		memcpy(work, pkts, n * SSDV_PKT_SIZE);
+		t[m] = now();
+		
+		for(c = 0; c < k; c++)
+		{
+			w[c].pkts  = work;
+			w[c].first = (uint64_t) n * c / k;
+			w[c].count = (uint64_t) n * (c + 1) / k - w[c].first;
+			pthread_create(&th[c], NULL, rs8dec_worker, &w[c]);
+		}
+		for(c = 0, ok = 0; c < k; c++)
+		{
+			pthread_join(th[c], NULL);
+			ok += w[c].ok;
+		}
+		
+		t[m] = now() - t[m];
+		
+		/* Each packet is either put right, or left as it came */
+		for(i = 0; i < n; i++)
+		{
+			uint8_t *p = &work[i * SSDV_PKT_SIZE];
+			
+			if(memcmp(p, &sent[i * SSDV_PKT_SIZE], SSDV_PKT_SIZE) != 0 &&
+			   memcmp(p, &pkts[i * SSDV_PKT_SIZE], SSDV_PKT_SIZE) != 0) bad++;
+		}
+	}
+	
+	printf("RS decoding, %lu packets of %i bytes, %lu roots, %lu bytes wrong, %lu passed\n",
+		(unsigned long) n, SSDV_PKT_SIZE, (unsigned long) roots, (unsigned long) errors, (unsigned long) ok);
+	printf("Threads      packets/s\n");
+	printf("%7i   %12.0f\n", 1, n / t[0]);
+	printf("%7i   %12.0f  (%.1fx)\n", threads, n / t[1], t[0] / t[1]);
+	
+	free(sent);
+	free(pkts);
+	free(work);
+	
+	if(bad) printf("%i packets were changed but not corrected!\n", bad);
+	
+	return(bad ? 1 : 0);
+}
+
+/*****************************************************************************/
+
+/* replay - Decoding a capture of packets as they arrive and making the
+ * JPEG again as a ground station does, by feeding ssdv_dec_feed() every
+ * packet so far against the out of order decoder, which only decodes the
+ * runs of packets that are new. Make a capture with ssdvbatch */
+
+/* Both passes of a progressive image have its ID, and are decoded together */
+#define REPLAY_IMAGE(p) ((p)[6])
+
+typedef struct
+{
+	ssdv_image_t *img;
+	uint16_t *ids;
+	uint32_t n;
+	uint32_t next;
+	pthread_mutex_t lock;
+} replay_work_t;
+
+static void *replay_worker(void *arg)
+{
+	replay_work_t *w = arg;
+	uint32_t i;
+	
+	for(;;)
+	{
+		pthread_mutex_lock(&w->lock);
+		i = w->next++;
+		pthread_mutex_unlock(&w->lock);
+		
+		if(i >= w->n) break;
+		ssdv_dec_image_run(w->img, w->ids[i]);
+	}
+	
+	return(NULL);
+}
+
+/* Decode the n packets of one image in the order given with decoder m,
+ * making the JPEG every 'batch' packets and after the last. 0 is
+ * ssdv_dec_feed(), 1 and up the out of order decoder on m threads */
+static double replay_image(uint8_t **pkts, uint32_t n, int m, uint32_t batch, uint8_t *jpeg, size_t *length)
+{
+	static uint8_t *byid[0x10000];
+	static int16_t dcs[SSDV_DC_LEN(4080, 4080)];
+	pthread_t threads[64];
+	replay_work_t w;
+	ssdv_image_t img;
+	ssdv_t s;
+	uint8_t *b;
+	size_t l = *length;
+	uint32_t i, id, top = 0;
+	double t = now();
+	int k;
+	
+	memset(byid, 0, sizeof(byid));
+	ssdv_dec_image_init(&img);
+	pthread_mutex_init(&w.lock, NULL);
+	
+	for(i = 0; i < n; i++)
+	{
+		if(m == 0)
+		{
+			id = (pkts[i][7] << 8) | pkts[i][8];
+			byid[id] = pkts[i];
+			if(id >= top) top = id + 1;
+		}
+		else ssdv_dec_image_feed(&img, pkts[i]);
+		
+		if((batch == 0 || (i + 1) % batch) && i + 1 < n) continue;
+		
+		*length = l;
+		
+		if(m == 0)
+		{
+			/* Everything again, in order */
+			ssdv_dec_init(&s);
+			ssdv_dec_set_buffer(&s, jpeg, l);
+			ssdv_dec_set_dc(&s, dcs, SSDV_DC_LEN(4080, 4080));
+			for(id = 0; id < top; id++)
+				if(byid[id]) ssdv_dec_feed(&s, byid[id]);
+			if(ssdv_dec_get_jpeg(&s, &b, length) != SSDV_OK) *length = 0;
+			continue;
+		}
+		
+		/* The new runs, spread over the threads. The DC pass of a
+		 * progressive image is given first, then the AC pass */
+		w.img = &img;
+		while(m > 1 && (w.n = ssdv_dec_image_runs(&img, &w.ids)) > 0)
+		{
+			w.next = 0;
+			for(k = 0; k < m && k < (int) w.n; k++)
+				pthread_create(&threads[k], NULL, replay_worker, &w);
+			while(k-- > 0) pthread_join(threads[k], NULL);
+		}
+		
+		if(ssdv_dec_image_jpeg(&img, jpeg, length) != SSDV_OK) *length = 0;
+	}
+	
+	t = now() - t;
+	
+	pthread_mutex_destroy(&w.lock);
+	ssdv_dec_image_free(&img);
+	
+	return(t);
+}
+
+static int bench_replay(int argc, char *argv[])
+{
+	uint8_t *data, *p, **pkts, **x, *jpeg[2];
+	uint32_t i, j, n = 0, first, batch = 1, window = 0, loss = 0, images = 0;
+	size_t len, length[2], jpeg_len = 1 << 22;
+	double t[3] = { 0, 0, 0 };
+	int c, m, threads = sysconf(_SC_NPROCESSORS_ONLN), bad = 0;
+	FILE *f;
+	
+	while((c = getopt(argc, argv, "t:b:s:d:")) != -1)
+	{
+		switch(c)
+		{
+		case 't': threads = atoi(optarg); break;
+		case 'b': batch = atol(optarg); break;
+		case 's': window = atol(optarg); break;
+		case 'd': loss = atol(optarg); break;
+		default: return(-1);
+		}
+	}
+	
+	if(optind >= argc || threads < 1 || threads > 64)
+	{
+		fprintf(stderr, "Usage: ssdvbench replay [-t threads] [-b batch] [-s shuffle] [-d loss%%] <packets>\n");
+		return(-1);
+	}
+	
+	/* Read in the capture */
+	if(!(f = fopen(argv[optind], "rb")))
+	{
+		fprintf(stderr, "Error opening '%s'\n", argv[optind]);
+		return(-1);
+	}
+	
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	rewind(f);
+	data = malloc(len + SSDV_PKT_SIZE);
+	pkts = malloc((len / SSDV_PKT_SIZE_MIN + 1) * sizeof(uint8_t *));
+	jpeg[0] = malloc(jpeg_len);
+	jpeg[1] = malloc(jpeg_len);
+	if(!data || !pkts || !jpeg[0] || !jpeg[1] || fread(data, 1, len, f) != len) return(-1);
+	fclose(f);
+	
+	/* Parity packets are left out, neither decoder uses them */
+	for(p = data; p + SSDV_PKT_SIZE_MIN <= data + len; p += ssdv_pkt_size(p))
+		if(ssdv_dec_is_packet(p) == SSDV_OK && !SSDV_IS_TYPE(p[1], SSDV_TYPE_PARITY)) pkts[n++] = p;
+	
+	/* Lose some, and move each of the rest up to 'window' places on */
+	srand(1);
+	for(i = j = 0; i < n; i++)
+		if(rand() % 100 >= (int) loss) pkts[j++] = pkts[i];
+	n = j;
+	
+	for(i = 0; window && i < n; i++)
+	{
+		j = i + rand() % (window + 1);
+		if(j >= n || REPLAY_IMAGE(pkts[j]) != REPLAY_IMAGE(pkts[i])) continue;
+		p = pkts[i];
+		pkts[i] = pkts[j];
+		pkts[j] = p;
+	}
+	
+	printf("Replaying %lu packets, %lu%% lost, moved up to %lu places, JPEG made every %lu\n",
+		(unsigned long) n, (unsigned long) loss, (unsigned long) window, (unsigned long) batch);
+	
+	/* Each image in turn, by all three decoders */
+	for(first = 0; first < n; first = i, images++)
+	{
+		for(i = first; i < n && REPLAY_IMAGE(pkts[i]) == REPLAY_IMAGE(pkts[first]); i++);
+		x = &pkts[first];
+		
+		for(m = 0; m < 3; m++)
+		{
+			length[m ? 1 : 0] = jpeg_len;
+			t[m] += replay_image(x, i - first, m == 2 ? threads : m, batch, jpeg[m ? 1 : 0], &length[m ? 1 : 0]);
+			
+			/* All three give the same image, unless some of the per-image
+			 * tables were lost. Only ssdv_dec_image_feed() goes back over
+			 * the packets that came before the rest of them */
+			if(m > 0 && !(loss && (SSDV_PKT_FLAGS(x[0][1]) & SSDV_TYPE_HUFF)) &&
+			   (length[0] != length[1] || memcmp(jpeg[0], jpeg[1], length[0]) != 0)) bad++;
+		}
+	}
+	
+	printf("%lu images\n", (unsigned long) images);
+	printf("Decoder                   time     packets/s\n");
+	printf("ssdv_dec_feed, all     %7.3f s  %9.0f\n", t[0], n / t[0]);
+	printf("image, 1 thread        %7.3f s  %9.0f  (%.1fx)\n", t[1], n / t[1], t[0] / t[1]);
+	printf("image, %2i threads      %7.3f s  %9.0f  (%.1fx)\n", threads, t[2], n / t[2], t[0] / t[2]);
+	
+	free(data);
+	free(pkts);
+	free(jpeg[0]);
+	free(jpeg[1]);
+	
+	if(bad) printf("The decoders gave different images for %i tests!\n", bad);
+	
+	return(bad ? 1 : 0);
+}
+
+/*****************************************************************************/
+
+static const struct
+{
+	const char *name;
+	int (*run)(int argc, char *argv[]);
+	const char *about;
+	
+} benches[] = {
+	{ "huff", bench_huff, "[symbols] Huffman decoding of the source JPEG, symbols/s" },
+	{ "outbits", bench_outbits, "[codes] Writing the output bit stream, codes/s" },
+	{ "rs8enc", bench_rs8enc, "[packets] RS encoding of a 256 byte packet, cycles/packet" },
+	{ "rs8dec", bench_rs8dec, "[-t threads] [-e errors] [-r roots] [packets] Correcting packets, packets/s" },
+	{ "replay", bench_replay, "[-t threads] [-b batch] [-s shuffle] [-d loss%] <packets> Decoding a capture" },
+};
+
+#define BENCHES (sizeof(benches) / sizeof(benches[0]))
+
+static void usage(void)
+{
+	size_t i;
+	
+	fprintf(stderr, "Usage: ssdvbench <test> [options]\n\n");
+	for(i = 0; i < BENCHES; i++)
+		fprintf(stderr, "  %-8s %s\n", benches[i].name, benches[i].about);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t i;
+	
+	if(argc < 2)
+	{
+		usage();
+		return(-1);
+	}
+	
+	for(i = 0; i < BENCHES; i++)
+		if(strcmp(argv[1], benches[i].name) == 0)
+			return(benches[i].run(argc - 1, argv + 1));
+	
+	usage();
+	return(-1);
+}
+
@@ -0,0 +1,249 @@
+
+/* ssdvsim - Send SSDV packets over a simulated lossy link               */
+/*=======================================================================*/
+/* Copyright 2026 agent <agent@local>                                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* This is a host tool, not part of the flight firmware. It reads the
+ * packets written by ssdvbatch and sends them many times over a link
+ * that loses packets in bursts, counting how many of the images arrive
+ * complete. Lost packets are rebuilt from any parity packets first.
+ * 
+ * The link is good or bad, losing every packet while bad. It turns bad
+ * and good again at random, so that the mean loss and the mean length
+ * of a burst are as given. A burst length of 1 is independent losses. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "ssdv.h"
+
+typedef struct
+{
+	uint8_t *pkts;  /* The image's packets, in the order sent */
+	int count;
+	int slots;      /* Packet IDs of the image data, 0 to slots - 1 */
+	
+} image_t;
+
+static int pkt_size = SSDV_PKT_SIZE;
+static double loss = 10;
+static double burst = 1;
+static int trials = 1000;
+static long seed = 1;
+
+static image_t *images;
+static int image_count;
+
+static int read_images(FILE *f)
+{
+	uint8_t pkt[SSDV_PKT_SIZE];
+	ssdv_packet_info_t p;
+	image_t *img = NULL;
+	int image_id = -1;
+	
+	while(fread(pkt, 1, pkt_size, f) == (size_t) pkt_size)
+	{
+		if(ssdv_dec_is_packet(pkt) != SSDV_OK) continue;
+		ssdv_dec_header(&p, pkt);
+		if(p.pkt_size != pkt_size) continue;
+		
+		/* The packets of each image come together */
+		if(p.image_id != image_id)
+		{
+			image_t *i = realloc(images, (image_count + 1) * sizeof(image_t));
+			if(!i) return(-1);
+			images = i;
+			img = &images[image_count++];
+			memset(img, 0, sizeof(image_t));
+			image_id = p.image_id;
+		}
+		
+		if(!(img->count & 63))
+		{
+			uint8_t *k = realloc(img->pkts, (img->count + 64) * pkt_size);
+			if(!k) return(-1);
+			img->pkts = k;
+		}
+		
+		memcpy(&img->pkts[img->count++ * pkt_size], pkt, pkt_size);
+		if(!p.parity && p.packet_id >= img->slots) img->slots = p.packet_id + 1;
+	}
+	
+	return(0);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"Usage: ssdvsim [options] <packets>\n"
+		"\n"
+		"  -l Packet length, 64 to 256 bytes in steps of 32 (default 256)\n"
+		"  -p Mean packet loss in percent (default 10)\n"
+		"  -b Mean length of a burst of lost packets (default 1)\n"
+		"  -n Number of times to send the images (default 1000)\n"
+		"  -s Seed for the random losses (default 1)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	uint8_t *pkts, *have, *parity;
+	double p_bad, p_good;
+	long sent = 0, lost = 0, sent_parity = 0, missing[2] = { 0, 0 }, complete[2] = { 0, 0 };
+	long rebuilt = 0, wrong = 0;
+	int c, i, t, k, np, bad = 0, max = 0;
+	FILE *f;
+	
+	while((c = getopt(argc, argv, "l:p:b:n:s:")) != -1)
+	{
+		switch(c)
+		{
+		case 'l': pkt_size = atoi(optarg); break;
+		case 'p': loss = atof(optarg); break;
+		case 'b': burst = atof(optarg); break;
+		case 'n': trials = atoi(optarg); break;
+		case 's': seed = atol(optarg); break;
+		default: usage(); return(-1);
+		}
+	}
+	
+	if(argc - optind != 1)
+	{
+		usage();
+		return(-1);
+	}
+	
+	if(pkt_size < SSDV_PKT_SIZE_MIN || pkt_size > SSDV_PKT_SIZE || pkt_size % 32)
+	{
+		fprintf(stderr, "Packet length must be 64 to 256 bytes, in steps of 32\n");
+		return(-1);
+	}
+	
+	if(loss < 0 || loss >= 100 || burst < 1 || trials <= 0)
+	{
+		fprintf(stderr, "Loss must be 0 to 99%%, bursts at least 1 packet long\n");
+		return(-1);
+	}
+	
+	if(!(f = fopen(argv[optind], "rb")))
+	{
+		fprintf(stderr, "Error opening '%s'\n", argv[optind]);
+		return(-1);
+	}
+	
+	c = read_images(f);
+	fclose(f);
+	if(c != 0 || image_count == 0)
+	{
+		fprintf(stderr, "No packets read\n");
+		return(-1);
+	}
+	
+	for(i = 0; i < image_count; i++)
+	{
+		if(images[i].count > max) max = images[i].count;
+		if(images[i].slots > max) max = images[i].slots;
+	}
+	
+	pkts = malloc(max * pkt_size);
+	parity = malloc(max * pkt_size);
+	have = malloc(max);
+	if(!pkts || !parity || !have) return(-1);
+	
+	/* The chance of the link turning bad or good before each packet */
+	p_good = 1 / burst;
+	p_bad = (loss / 100) / (1 - loss / 100) * p_good;
+	
+	srand48(seed);
+	
+	for(t = 0; t < trials; t++)
+	{
+		for(i = 0; i < image_count; i++)
+		{
+			image_t *img = &images[i];
+			int m[2] = { 0, 0 };
+			
+			memset(have, 0, img->slots);
+			
+			/* Send the image. The receiver keeps the image data by
+			 * packet ID, and the parity packets to one side */
+			for(k = 0, np = 0; k < img->count; k++)
+			{
+				uint8_t *x = &img->pkts[k * pkt_size];
+				ssdv_packet_info_t p;
+				
+				ssdv_dec_header(&p, x);
+				bad = (bad ? drand48() >= p_good : drand48() < p_bad);
+				
+				sent++;
+				if(bad) lost++;
+				
+				if(p.parity)
+				{
+					sent_parity++;
+					if(!bad) memcpy(&parity[np++ * pkt_size], x, pkt_size);
+				}
+				else if(bad) m[0]++;
+				else
+				{
+					memcpy(&pkts[p.packet_id * pkt_size], x, pkt_size);
+					have[p.packet_id] = 1;
+				}
+			}
+			
+			/* Rebuild what can be, and check it's right */
+			rebuilt += ssdv_dec_recover(pkts, pkt_size, have, img->slots, parity, np);
+			
+			for(k = 0; k < img->count; k++)
+			{
+				uint8_t *x = &img->pkts[k * pkt_size];
+				ssdv_packet_info_t p;
+				
+				ssdv_dec_header(&p, x);
+				if(p.parity) continue;
+				
+				if(!have[p.packet_id]) m[1]++;
+				else if(memcmp(&pkts[p.packet_id * pkt_size], x, pkt_size) != 0) wrong++;
+			}
+			
+			missing[0] += m[0];
+			missing[1] += m[1];
+			if(m[0] == 0) complete[0]++;
+			if(m[1] == 0) complete[1]++;
+		}
+	}
+	
+	printf("%i images sent %i times, %.1f%% of the packets parity\n",
+		image_count, trials, 100.0 * sent_parity / sent);
+	printf("%.2f%% of packets lost, mean burst %.1f packets\n",
+		100.0 * lost / sent, burst);
+	printf("Images complete as received:    %6.2f%% (%.2f%% of the data lost)\n",
+		100.0 * complete[0] / (image_count * trials), 100.0 * missing[0] / (sent - sent_parity));
+	printf("Images complete after recovery: %6.2f%% (%.2f%% of the data lost)\n",
+		100.0 * complete[1] / (image_count * trials), 100.0 * missing[1] / (sent - sent_parity));
+	
+	if(wrong) printf("%li of %li rebuilt packets are wrong!\n", wrong, rebuilt);
+	
+	free(pkts);
+	free(parity);
+	free(have);
+	for(i = 0; i < image_count; i++) free(images[i].pkts);
+	free(images);
+	
+	return(wrong ? 1 : 0);
+}
+
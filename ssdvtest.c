@@ -0,0 +1,308 @@
+
+/* ssdvtest - Check parts of the SSDV encoder on the host                */
+/*=======================================================================*/
+/* Copyright 2026 agent <agent@local>                                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* This is a host tool, run by "make test". It includes ssdv.c, built
+ * with SSDV_TEST, to reach the code inside it and to switch parts of it
+ * back to the plain code they replaced. Any JPEG files given are encoded
+ * both ways and the packets compared. They are also sent progressively,
+ * and the two passes decoded must give the same JPEG as one full pass. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "ssdv.c"
+
+/* The largest quantised coefficient, times the largest DQT value */
+#define COEF_MAX (2047 * 255)
+
+static int test_rdiv(void)
+{
+	int i, div, bad = 0;
+	uint32_t rcp;
+	
+	for(div = 1; div < 256; div++)
+	{
+		rcp = rdiv_rcp_make(div);
+		
+		for(i = -COEF_MAX; i <= COEF_MAX; i++)
+		{
+			if(rdiv(i, div) != irdiv(i, div) && bad++ < 10)
+				printf("rdiv(%i, %i) gave %i, not %i\n", i, div, rdiv(i, div), irdiv(i, div));
+			
+			if(rdiv_rcp(i, div, rcp) != irdiv(i, div) && bad++ < 10)
+				printf("rdiv_rcp(%i, %i) gave %i, not %i\n", i, div, rdiv_rcp(i, div, rcp), irdiv(i, div));
+		}
+	}
+	
+	printf("rdiv, rdiv_rcp: %i to %i by 1 to 255, %i wrong\n", -COEF_MAX, COEF_MAX, bad);
+	
+	return(bad);
+}
+
+/* Encode a whole image onto the end of a buffer, which is grown as
+ * needed. The packet IDs carry on from any packets already there */
+static char encode(uint8_t *jpeg, size_t length, uint8_t quality, uint8_t scale, uint8_t type, uint8_t **pkts, size_t *count)
+{
+	static int16_t sbuf[SSDV_SCALE_LEN(4080, SSDV_SCALE_QUARTER)];
+	size_t pkts_len = *count;
+	uint8_t *p;
+	ssdv_t s;
+	char r;
+	
+	ssdv_enc_init(&s, "TEST", 0, SSDV_PKT_SIZE, quality);
+	ssdv_enc_set_type(&s, type);
+	ssdv_enc_set_scale(&s, scale, sbuf, SSDV_SCALE_LEN(4080, scale));
+	ssdv_enc_feed(&s, jpeg, length);
+	s.packet_id = *count;
+	
+	while(1)
+	{
+		if(*count == pkts_len)
+		{
+			pkts_len = (pkts_len ? pkts_len * 2 : 64);
+			if(!(p = realloc(*pkts, pkts_len * SSDV_PKT_SIZE))) return(SSDV_ERROR);
+			*pkts = p;
+		}
+		
+		ssdv_enc_set_buffer(&s, &(*pkts)[*count * SSDV_PKT_SIZE]);
+		
+		r = ssdv_enc_get_packet(&s);
+		if(r != SSDV_OK) break;
+		
+		(*count)++;
+	}
+	
+	return(r);
+}
+
+/* Count the packets for rate control, as ssdvbatch does */
+static void prescan(uint8_t *jpeg, size_t length, uint8_t scale, ssdv_stats_t *stats)
+{
+	static int16_t sbuf[SSDV_SCALE_LEN(4080, SSDV_SCALE_QUARTER)];
+	uint8_t pkt[SSDV_PKT_SIZE];
+	ssdv_t s;
+	
+	ssdv_enc_init(&s, "TEST", 0, SSDV_PKT_SIZE, SSDV_QUALITY_DEFAULT);
+	ssdv_enc_set_scale(&s, scale, sbuf, SSDV_SCALE_LEN(4080, scale));
+	ssdv_enc_set_buffer(&s, pkt);
+	ssdv_enc_prescan(&s, stats);
+	ssdv_enc_feed(&s, jpeg, length);
+	while(ssdv_enc_get_packet(&s) == SSDV_OK);
+}
+
+static uint8_t *read_file(const char *filename, size_t *length)
+{
+	uint8_t *data;
+	FILE *f;
+	
+	if(!(f = fopen(filename, "rb")))
+	{
+		printf("%s: Error opening file\n", filename);
+		return(NULL);
+	}
+	
+	fseek(f, 0, SEEK_END);
+	*length = ftell(f);
+	rewind(f);
+	data = malloc(*length);
+	if(!data || fread(data, 1, *length, f) != *length)
+	{
+		printf("%s: Error reading file\n", filename);
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	
+	return(data);
+}
+
+/* Every quality and scale, with rdiv() and then irdiv() */
+static int test_encode(const char *filename)
+{
+	uint8_t *jpeg, *pkts[2];
+	ssdv_stats_t stats[2];
+	size_t length, count[2];
+	uint8_t q, scale;
+	int tests = 0, bad = 0;
+	char r[2];
+	
+	if(!(jpeg = read_file(filename, &length))) return(1);
+	
+	for(scale = 0; scale <= SSDV_SCALE_QUARTER; scale++)
+	{
+		for(q = 0; q < SSDV_QUALITY_LEVELS; q++)
+		{
+			pkts[0] = pkts[1] = NULL;
+			count[0] = count[1] = 0;
+			
+			rdiv_exact = 0;
+			r[0] = encode(jpeg, length, q, scale, 0, &pkts[0], &count[0]);
+			rdiv_exact = 1;
+			r[1] = encode(jpeg, length, q, scale, 0, &pkts[1], &count[1]);
+			rdiv_exact = 0;
+			
+			/* Both must fail alike, as downscaling does with some images */
+			if(r[0] != r[1] || count[0] != count[1] ||
+			   memcmp(pkts[0], pkts[1], count[0] * SSDV_PKT_SIZE) != 0)
+			{
+				printf("%s: Quality %i, scale %i differs\n", filename, q, scale);
+				bad++;
+			}
+			else if(r[0] == SSDV_EOI) tests++;
+			
+			free(pkts[0]);
+			free(pkts[1]);
+		}
+		
+		/* The estimates of the other qualities use it too */
+		rdiv_exact = 0;
+		prescan(jpeg, length, scale, &stats[0]);
+		rdiv_exact = 1;
+		prescan(jpeg, length, scale, &stats[1]);
+		rdiv_exact = 0;
+		
+		if(memcmp(&stats[0], &stats[1], sizeof(ssdv_stats_t)) != 0)
+		{
+			printf("%s: Rate control estimates at scale %i differ\n", filename, scale);
+			bad++;
+		}
+	}
+	
+	printf("%s: %i encodes the same, %i differ\n", filename, tests, bad);
+	free(jpeg);
+	
+	return(bad);
+}
+
+/* Decode the packets in order, every 'skip'th lost if it's not 0 */
+static size_t decode_feed(uint8_t *pkts, size_t count, size_t skip, uint8_t *jpeg, size_t length)
+{
+	static int16_t dcs[SSDV_DC_LEN(4080, 4080)];
+	uint8_t *b;
+	size_t i;
+	ssdv_t s;
+	
+	ssdv_dec_init(&s);
+	ssdv_dec_set_buffer(&s, jpeg, length);
+	ssdv_dec_set_dc(&s, dcs, SSDV_DC_LEN(4080, 4080));
+	
+	for(i = 0; i < count; i++)
+		if(!skip || i % skip != skip - 1) ssdv_dec_feed(&s, &pkts[i * SSDV_PKT_SIZE]);
+	
+	if(ssdv_dec_get_jpeg(&s, &b, &length) != SSDV_OK) return(0);
+	
+	return(length);
+}
+
+/* The same with the out of order decoder, the packets fed in backwards */
+static size_t decode_image(uint8_t *pkts, size_t count, size_t skip, uint8_t *jpeg, size_t length)
+{
+	ssdv_image_t img;
+	size_t i;
+	
+	ssdv_dec_image_init(&img);
+	
+	for(i = count; i-- > 0;)
+		if(!skip || i % skip != skip - 1) ssdv_dec_image_feed(&img, &pkts[i * SSDV_PKT_SIZE]);
+	
+	if(ssdv_dec_image_jpeg(&img, jpeg, &length) != SSDV_OK) length = 0;
+	ssdv_dec_image_free(&img);
+	
+	return(length);
+}
+
+/* The DC pass and then the AC pass, against a single full pass */
+static int test_progressive(const char *filename)
+{
+	static uint8_t out[3][1 << 22];
+	uint8_t *jpeg, *pkts[2] = { NULL, NULL };
+	size_t length, count[2] = { 0, 0 }, dc, l[3];
+	int bad = 0;
+	
+	if(!(jpeg = read_file(filename, &length))) return(1);
+	
+	if(encode(jpeg, length, SSDV_QUALITY_DEFAULT, 0, 0, &pkts[0], &count[0]) != SSDV_EOI ||
+	   encode(jpeg, length, SSDV_QUALITY_DEFAULT, 0, SSDV_TYPE_DC, &pkts[1], &count[1]) != SSDV_EOI)
+	{
+		printf("%s: Error encoding\n", filename);
+		bad++;
+	}
+	
+	dc = count[1];
+	if(!bad && encode(jpeg, length, SSDV_QUALITY_DEFAULT, 0, SSDV_TYPE_AC, &pkts[1], &count[1]) != SSDV_EOI)
+	{
+		printf("%s: Error encoding the AC pass\n", filename);
+		bad++;
+	}
+	
+	if(!bad)
+	{
+		/* All the packets, both passes together make the full image */
+		l[0] = decode_feed(pkts[0], count[0], 0, out[0], sizeof(out[0]));
+		l[1] = decode_feed(pkts[1], count[1], 0, out[1], sizeof(out[1]));
+		l[2] = decode_image(pkts[1], count[1], 0, out[2], sizeof(out[2]));
+		if(l[0] == 0 || l[0] != l[1] || l[0] != l[2] ||
+		   memcmp(out[0], out[1], l[0]) != 0 || memcmp(out[0], out[2], l[0]) != 0)
+		{
+			printf("%s: The two passes don't make the full image\n", filename);
+			bad++;
+		}
+		
+		/* Only the DC pass, both decoders alike */
+		l[1] = decode_feed(pkts[1], dc, 0, out[1], sizeof(out[1]));
+		l[2] = decode_image(pkts[1], dc, 0, out[2], sizeof(out[2]));
+		if(l[1] == 0 || l[1] != l[2] || memcmp(out[1], out[2], l[1]) != 0)
+		{
+			printf("%s: The DC pass decodes differently\n", filename);
+			bad++;
+		}
+		
+		/* Lost packets in both passes, both decoders alike */
+		l[1] = decode_feed(pkts[1], count[1], 5, out[1], sizeof(out[1]));
+		l[2] = decode_image(pkts[1], count[1], 5, out[2], sizeof(out[2]));
+		if(l[1] == 0 || l[1] != l[2] || memcmp(out[1], out[2], l[1]) != 0)
+		{
+			printf("%s: The two passes with losses decode differently\n", filename);
+			bad++;
+		}
+	}
+	
+	printf("%s: %lu packets, or %lu DC and %lu AC, %s\n", filename, (unsigned long) count[0],
+		(unsigned long) dc, (unsigned long) (count[1] - dc), bad ? "failed" : "the same");
+	
+	free(pkts[0]);
+	free(pkts[1]);
+	free(jpeg);
+	
+	return(bad);
+}
+
+int main(int argc, char *argv[])
+{
+	int i, bad;
+	
+	bad = test_rdiv();
+	for(i = 1; i < argc; i++)
+		bad += test_encode(argv[i]) + test_progressive(argv[i]);
+	
+	printf(bad ? "FAILED\n" : "PASSED\n");
+	
+	return(bad ? 1 : 0);
+}
+
@@ -0,0 +1,126 @@
+/* Made by dhcgen, do not edit */
+
+PROGMEM static uint8_t const std_dhc00[48] = {
+0x02,0x00,0x00,0x03,0x00,0x02,0x03,0x00,0x03,0x03,0x00,0x04,0x03,0x00,0x05,
+0x03,0x00,0x06,0x04,0x00,0x0E,0x05,0x00,0x1E,0x06,0x00,0x3E,0x07,0x00,0x7E,
+0x08,0x00,0xFE,0x09,0x01,0xFE,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,
+};
+
+PROGMEM static uint8_t const std_dhc01[48] = {
+0x02,0x00,0x00,0x02,0x00,0x01,0x02,0x00,0x02,0x03,0x00,0x06,0x04,0x00,0x0E,
+0x05,0x00,0x1E,0x06,0x00,0x3E,0x07,0x00,0x7E,0x08,0x00,0xFE,0x09,0x01,0xFE,
+0x0A,0x03,0xFE,0x0B,0x07,0xFE,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,
+};
+
+PROGMEM static uint8_t const std_dhc10[768] = {
+0x04,0x00,0x0A,0x02,0x00,0x00,0x02,0x00,0x01,0x03,0x00,0x04,0x04,0x00,0x0B,
+0x05,0x00,0x1A,0x07,0x00,0x78,0x08,0x00,0xF8,0x0A,0x03,0xF6,0x10,0xFF,0x82,
+0x10,0xFF,0x83,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x04,0x00,0x0C,0x05,0x00,0x1B,0x07,0x00,0x79,
+0x09,0x01,0xF6,0x0B,0x07,0xF6,0x10,0xFF,0x84,0x10,0xFF,0x85,0x10,0xFF,0x86,
+0x10,0xFF,0x87,0x10,0xFF,0x88,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x05,0x00,0x1C,0x08,0x00,0xF9,
+0x0A,0x03,0xF7,0x0C,0x0F,0xF4,0x10,0xFF,0x89,0x10,0xFF,0x8A,0x10,0xFF,0x8B,
+0x10,0xFF,0x8C,0x10,0xFF,0x8D,0x10,0xFF,0x8E,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x06,0x00,0x3A,
+0x09,0x01,0xF7,0x0C,0x0F,0xF5,0x10,0xFF,0x8F,0x10,0xFF,0x90,0x10,0xFF,0x91,
+0x10,0xFF,0x92,0x10,0xFF,0x93,0x10,0xFF,0x94,0x10,0xFF,0x95,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x06,0x00,0x3B,0x0A,0x03,0xF8,0x10,0xFF,0x96,0x10,0xFF,0x97,0x10,0xFF,0x98,
+0x10,0xFF,0x99,0x10,0xFF,0x9A,0x10,0xFF,0x9B,0x10,0xFF,0x9C,0x10,0xFF,0x9D,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x07,0x00,0x7A,0x0B,0x07,0xF7,0x10,0xFF,0x9E,0x10,0xFF,0x9F,
+0x10,0xFF,0xA0,0x10,0xFF,0xA1,0x10,0xFF,0xA2,0x10,0xFF,0xA3,0x10,0xFF,0xA4,
+0x10,0xFF,0xA5,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x07,0x00,0x7B,0x0C,0x0F,0xF6,0x10,0xFF,0xA6,
+0x10,0xFF,0xA7,0x10,0xFF,0xA8,0x10,0xFF,0xA9,0x10,0xFF,0xAA,0x10,0xFF,0xAB,
+0x10,0xFF,0xAC,0x10,0xFF,0xAD,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x08,0x00,0xFA,0x0C,0x0F,0xF7,
+0x10,0xFF,0xAE,0x10,0xFF,0xAF,0x10,0xFF,0xB0,0x10,0xFF,0xB1,0x10,0xFF,0xB2,
+0x10,0xFF,0xB3,0x10,0xFF,0xB4,0x10,0xFF,0xB5,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x09,0x01,0xF8,
+0x0F,0x7F,0xC0,0x10,0xFF,0xB6,0x10,0xFF,0xB7,0x10,0xFF,0xB8,0x10,0xFF,0xB9,
+0x10,0xFF,0xBA,0x10,0xFF,0xBB,0x10,0xFF,0xBC,0x10,0xFF,0xBD,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x09,0x01,0xF9,0x10,0xFF,0xBE,0x10,0xFF,0xBF,0x10,0xFF,0xC0,0x10,0xFF,0xC1,
+0x10,0xFF,0xC2,0x10,0xFF,0xC3,0x10,0xFF,0xC4,0x10,0xFF,0xC5,0x10,0xFF,0xC6,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x09,0x01,0xFA,0x10,0xFF,0xC7,0x10,0xFF,0xC8,0x10,0xFF,0xC9,
+0x10,0xFF,0xCA,0x10,0xFF,0xCB,0x10,0xFF,0xCC,0x10,0xFF,0xCD,0x10,0xFF,0xCE,
+0x10,0xFF,0xCF,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x0A,0x03,0xF9,0x10,0xFF,0xD0,0x10,0xFF,0xD1,
+0x10,0xFF,0xD2,0x10,0xFF,0xD3,0x10,0xFF,0xD4,0x10,0xFF,0xD5,0x10,0xFF,0xD6,
+0x10,0xFF,0xD7,0x10,0xFF,0xD8,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x0A,0x03,0xFA,0x10,0xFF,0xD9,
+0x10,0xFF,0xDA,0x10,0xFF,0xDB,0x10,0xFF,0xDC,0x10,0xFF,0xDD,0x10,0xFF,0xDE,
+0x10,0xFF,0xDF,0x10,0xFF,0xE0,0x10,0xFF,0xE1,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x0B,0x07,0xF8,
+0x10,0xFF,0xE2,0x10,0xFF,0xE3,0x10,0xFF,0xE4,0x10,0xFF,0xE5,0x10,0xFF,0xE6,
+0x10,0xFF,0xE7,0x10,0xFF,0xE8,0x10,0xFF,0xE9,0x10,0xFF,0xEA,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x10,0xFF,0xEB,0x10,0xFF,0xEC,0x10,0xFF,0xED,0x10,0xFF,0xEE,0x10,0xFF,0xEF,
+0x10,0xFF,0xF0,0x10,0xFF,0xF1,0x10,0xFF,0xF2,0x10,0xFF,0xF3,0x10,0xFF,0xF4,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x0B,0x07,0xF9,0x10,0xFF,0xF5,0x10,0xFF,0xF6,0x10,0xFF,0xF7,0x10,0xFF,0xF8,
+0x10,0xFF,0xF9,0x10,0xFF,0xFA,0x10,0xFF,0xFB,0x10,0xFF,0xFC,0x10,0xFF,0xFD,
+0x10,0xFF,0xFE,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,
+};
+
+PROGMEM static uint8_t const std_dhc11[768] = {
+0x02,0x00,0x00,0x02,0x00,0x01,0x03,0x00,0x04,0x04,0x00,0x0A,0x05,0x00,0x18,
+0x05,0x00,0x19,0x06,0x00,0x38,0x07,0x00,0x78,0x09,0x01,0xF4,0x0A,0x03,0xF6,
+0x0C,0x0F,0xF4,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x04,0x00,0x0B,0x06,0x00,0x39,0x08,0x00,0xF6,
+0x09,0x01,0xF5,0x0B,0x07,0xF6,0x0C,0x0F,0xF5,0x10,0xFF,0x88,0x10,0xFF,0x89,
+0x10,0xFF,0x8A,0x10,0xFF,0x8B,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x05,0x00,0x1A,0x08,0x00,0xF7,
+0x0A,0x03,0xF7,0x0C,0x0F,0xF6,0x0F,0x7F,0xC2,0x10,0xFF,0x8C,0x10,0xFF,0x8D,
+0x10,0xFF,0x8E,0x10,0xFF,0x8F,0x10,0xFF,0x90,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x05,0x00,0x1B,
+0x08,0x00,0xF8,0x0A,0x03,0xF8,0x0C,0x0F,0xF7,0x10,0xFF,0x91,0x10,0xFF,0x92,
+0x10,0xFF,0x93,0x10,0xFF,0x94,0x10,0xFF,0x95,0x10,0xFF,0x96,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x06,0x00,0x3A,0x09,0x01,0xF6,0x10,0xFF,0x97,0x10,0xFF,0x98,0x10,0xFF,0x99,
+0x10,0xFF,0x9A,0x10,0xFF,0x9B,0x10,0xFF,0x9C,0x10,0xFF,0x9D,0x10,0xFF,0x9E,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x06,0x00,0x3B,0x0A,0x03,0xF9,0x10,0xFF,0x9F,0x10,0xFF,0xA0,
+0x10,0xFF,0xA1,0x10,0xFF,0xA2,0x10,0xFF,0xA3,0x10,0xFF,0xA4,0x10,0xFF,0xA5,
+0x10,0xFF,0xA6,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x07,0x00,0x79,0x0B,0x07,0xF7,0x10,0xFF,0xA7,
+0x10,0xFF,0xA8,0x10,0xFF,0xA9,0x10,0xFF,0xAA,0x10,0xFF,0xAB,0x10,0xFF,0xAC,
+0x10,0xFF,0xAD,0x10,0xFF,0xAE,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x07,0x00,0x7A,0x0B,0x07,0xF8,
+0x10,0xFF,0xAF,0x10,0xFF,0xB0,0x10,0xFF,0xB1,0x10,0xFF,0xB2,0x10,0xFF,0xB3,
+0x10,0xFF,0xB4,0x10,0xFF,0xB5,0x10,0xFF,0xB6,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x08,0x00,0xF9,
+0x10,0xFF,0xB7,0x10,0xFF,0xB8,0x10,0xFF,0xB9,0x10,0xFF,0xBA,0x10,0xFF,0xBB,
+0x10,0xFF,0xBC,0x10,0xFF,0xBD,0x10,0xFF,0xBE,0x10,0xFF,0xBF,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x09,0x01,0xF7,0x10,0xFF,0xC0,0x10,0xFF,0xC1,0x10,0xFF,0xC2,0x10,0xFF,0xC3,
+0x10,0xFF,0xC4,0x10,0xFF,0xC5,0x10,0xFF,0xC6,0x10,0xFF,0xC7,0x10,0xFF,0xC8,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x09,0x01,0xF8,0x10,0xFF,0xC9,0x10,0xFF,0xCA,0x10,0xFF,0xCB,
+0x10,0xFF,0xCC,0x10,0xFF,0xCD,0x10,0xFF,0xCE,0x10,0xFF,0xCF,0x10,0xFF,0xD0,
+0x10,0xFF,0xD1,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x09,0x01,0xF9,0x10,0xFF,0xD2,0x10,0xFF,0xD3,
+0x10,0xFF,0xD4,0x10,0xFF,0xD5,0x10,0xFF,0xD6,0x10,0xFF,0xD7,0x10,0xFF,0xD8,
+0x10,0xFF,0xD9,0x10,0xFF,0xDA,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x09,0x01,0xFA,0x10,0xFF,0xDB,
+0x10,0xFF,0xDC,0x10,0xFF,0xDD,0x10,0xFF,0xDE,0x10,0xFF,0xDF,0x10,0xFF,0xE0,
+0x10,0xFF,0xE1,0x10,0xFF,0xE2,0x10,0xFF,0xE3,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x0B,0x07,0xF9,
+0x10,0xFF,0xE4,0x10,0xFF,0xE5,0x10,0xFF,0xE6,0x10,0xFF,0xE7,0x10,0xFF,0xE8,
+0x10,0xFF,0xE9,0x10,0xFF,0xEA,0x10,0xFF,0xEB,0x10,0xFF,0xEC,0x00,0x00,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x0E,0x3F,0xE0,0x10,0xFF,0xED,0x10,0xFF,0xEE,0x10,0xFF,0xEF,0x10,0xFF,0xF0,
+0x10,0xFF,0xF1,0x10,0xFF,0xF2,0x10,0xFF,0xF3,0x10,0xFF,0xF4,0x10,0xFF,0xF5,
+0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x0A,0x03,0xFA,0x0F,0x7F,0xC3,0x10,0xFF,0xF6,0x10,0xFF,0xF7,0x10,0xFF,0xF8,
+0x10,0xFF,0xF9,0x10,0xFF,0xFA,0x10,0xFF,0xFB,0x10,0xFF,0xFC,0x10,0xFF,0xFD,
+0x10,0xFF,0xFE,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+0x00,0x00,0x00,
+};
+
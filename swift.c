@@ -146,38 +146,142 @@ void tx_aprs(int32_t lat, int32_t lon, int32_t alt)
 #endif
 
 #ifdef SSDV_ENABLED
-char tx_image(void)
+
+#ifdef SSDV_GRAYSCALE
+#define SSDV_IMAGE_TYPE (SSDV_TYPE_GRAY)
+#else
+#define SSDV_IMAGE_TYPE (0)
+#endif
+
+#ifdef SSDV_IMAGE_SCALE
+/* Room for the 320 pixel wide camera image */
+static int16_t ssdv_sbuf[SSDV_SCALE_LEN(320, SSDV_IMAGE_SCALE)];
+#endif
+
+/* Packets are encoded into a ring ahead of time, and the RTTY
+ * interrupt sends them from there between the telemetry */
+static uint8_t ssdv_slots[SSDV_RING_SLOTS * SSDV_PKT_LENGTH];
+static ssdv_ring_t ssdv_ring;
+
+#ifdef SSDV_PARITY_GROUP
+static uint8_t ssdv_par[SSDV_PARITY_LEN(SSDV_PKT_LENGTH, SSDV_PARITY_PACKETS)];
+#endif
+
+static void tx_image_init(ssdv_t *ssdv, uint8_t image_id, uint8_t q, uint8_t type)
+{
+	ssdv_enc_init(ssdv, RTTY_CALLSIGN, image_id, SSDV_PKT_LENGTH, q);
+	ssdv_enc_set_type(ssdv, type);
+	ssdv_enc_set_fec(ssdv, SSDV_FEC_ROOTS);
+#ifdef SSDV_IMAGE_SCALE
+	ssdv_enc_set_scale(ssdv, SSDV_IMAGE_SCALE, ssdv_sbuf, sizeof(ssdv_sbuf) / sizeof(int16_t));
+#endif
+#ifdef SSDV_IMAGE_CROP
+	ssdv_enc_set_crop(ssdv, SSDV_IMAGE_CROP);
+#endif
+#ifdef SSDV_PARITY_GROUP
+	ssdv_enc_set_parity(ssdv, SSDV_PARITY_GROUP, SSDV_PARITY_PACKETS, ssdv_par, sizeof(ssdv_par));
+#endif
+}
+
+static char tx_image_packet(ssdv_t *ssdv)
+{
+	char r;
+	
+	while((r = ssdv_enc_get_packet(ssdv)) == SSDV_FEED_ME)
+	{
+		uint8_t *img;
+		uint16_t l;
+		
+		/* Skip data the encoder doesn't want without reading it */
+		if(ssdv->in_skip) ssdv->in_skip -= c3_read(NULL, ssdv->in_skip);
+		
+		/* Feed the encoder straight from the camera's buffer */
+		l = c3_peek(&img);
+		if(l == 0) break;
+		
+		ssdv_enc_feed(ssdv, img, l);
+		c3_read(NULL, l);
+	}
+	
+	return(r);
+}
+
+/* The altitude is NULL while there's no GPS position */
+char tx_image(const int32_t *alt)
 {
 	static char setup = 0;
 	static uint8_t img_id = 0;
 	static ssdv_t ssdv;
-	static uint8_t pkt[SSDV_PKT_SIZE];
-	static uint8_t img[64];
+	static uint8_t q;
+	uint8_t *pkt;
 	int r;
 	
+	/* Nothing to do until a slot is free */
+	if(!(pkt = ssdv_ring_next(&ssdv_ring))) return(setup);
+	
 	if(!setup)
 	{
 		if((r = c3_open(SR_320x240)) != 0)
 		{
-			snprintf_P((char *) img, 64, PSTR("$$" RTTY_CALLSIGN ":Camera error %d\n"), r);
-			rtx_string((char *) img);
+			snprintf_P((char *) pkt, SSDV_PKT_LENGTH, PSTR("$$" RTTY_CALLSIGN ":Camera error %d\n"), r);
+			rtx_string((char *) pkt);
 			rtx_wait();
 			return(setup);
 		}
 		
 		setup = -1;
+		q = SSDV_QUALITY;
 		
-		ssdv_enc_init(&ssdv, RTTY_CALLSIGN, img_id++);
-		ssdv_enc_set_buffer(&ssdv, pkt);
+#ifdef SSDV_TARGET_PACKETS
+		{
+			static ssdv_stats_t stats;
+			
+			/* Scan the image once to find the quality that fits */
+			tx_image_init(&ssdv, img_id, q, SSDV_IMAGE_TYPE);
+			ssdv_enc_set_buffer(&ssdv, pkt);
+			ssdv_enc_prescan(&ssdv, &stats);
+			while(tx_image_packet(&ssdv) == SSDV_OK);
+			
+			q = ssdv_enc_quality(&ssdv, SSDV_TARGET_PACKETS);
+			c3_rewind();
+		}
+#endif
+		
+#ifdef SSDV_PROGRESSIVE
+		/* The DC pass first, at the same quality as the AC
+		 * pass so that together they make the full image */
+		tx_image_init(&ssdv, img_id++, q, SSDV_IMAGE_TYPE | SSDV_TYPE_DC);
+#else
+		tx_image_init(&ssdv, img_id++, q, SSDV_IMAGE_TYPE);
+#endif
+	}
+	else if(setup == 1)
+	{
+		uint16_t packet_id = ssdv.packet_id;
+		
+		/* The DC pass is done, read the image again for the AC
+		 * pass. The packet IDs carry on from the DC pass */
+		c3_rewind();
+		tx_image_init(&ssdv, img_id - 1, q, SSDV_IMAGE_TYPE | SSDV_TYPE_AC);
+		ssdv.packet_id = packet_id;
+		setup = -1;
 	}
 	
-	while((r = ssdv_enc_get_packet(&ssdv)) == SSDV_FEED_ME)
+#ifdef SSDV_NOFEC_BELOW
 	{
-		size_t r = c3_read(img, 64);
-		if(r == 0) break;
+		uint8_t fix = 0;
 		
-		ssdv_enc_feed(&ssdv, img, r);
+		/* The RS codes can be left out of any packet, the decoder
+		 * takes packets with or without them. Only a current 3D fix
+		 * below the altitude leaves them out, never a lost one */
+		if(alt && gps_get_lock(&fix, NULL, NULL, NULL) != GPS_OK) fix = 0;
+		ssdv_enc_set_fec(&ssdv, fix == 3 && *alt < SSDV_NOFEC_BELOW * 1000L ? 0 : SSDV_FEC_ROOTS);
 	}
+#endif
+	
+	/* Encode the packet straight into the free slot */
+	ssdv_enc_set_buffer(&ssdv, pkt);
+	r = tx_image_packet(&ssdv);
 	
 	if(r != SSDV_OK)
 	{
@@ -188,15 +292,20 @@ char tx_image(void)
 		return(setup);
 	}
 	
-	if(ssdv.state == S_EOI || c3_eof())
+	/* Any parity packets still follow the end of the image */
+	if(ssdv.state == S_EOI ? ssdv.par_next == ssdv.par_m : (c3_eof() && ssdv.in_len == 0))
 	{
 		/* The end of the image has been reached */
-		c3_close();
-		setup = 0;
+		if(ssdv.type & SSDV_TYPE_DC) setup = 1;
+		else
+		{
+			c3_close();
+			setup = 0;
+		}
 	}
 	
-	/* Got the packet! Transmit it */
-	rtx_data(pkt, SSDV_PKT_SIZE);
+	/* Got the packet! Queue it for the transmitter */
+	ssdv_ring_push(&ssdv_ring);
 	
 	return(setup);
 }
@@ -225,6 +334,8 @@ int main(void)
 
 #ifdef SSDV_ENABLED
 	c3_init();
+	ssdv_ring_init(&ssdv_ring, ssdv_slots, SSDV_RING_SLOTS, SSDV_PKT_LENGTH);
+	rtx_ring(&ssdv_ring);
 #endif
 	
 	sei();
@@ -279,7 +390,8 @@ int main(void)
 		}
 		
 		/* Get the latitude and longitude */
-		if(gps_get_pos(&lat, &lon, &alt) != GPS_OK)
+		r = gps_get_pos(&lat, &lon, &alt);
+		if(r != GPS_OK)
 		{
 			rtx_string_P(PSTR("$$" RTTY_CALLSIGN ",No or invalid GPS response\n"));
 			lat = lon = alt = 0;
@@ -328,7 +440,7 @@ int main(void)
 #endif
 
 #ifdef SSDV_ENABLED
-		if(tx_image() == -1)
+		if(tx_image(r == GPS_OK ? &alt : NULL) != 0)
 		{
 			/* The camera goes to sleep while transmitting telemetry,
 			 * sync'ing here seems to prevent it. */